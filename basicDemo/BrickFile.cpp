@@ -0,0 +1,394 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "BrickFile.h"
+#include "Parallel.h"
+#include "Storage.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const uint32_t brickFileVersion = 2;
+
+	// Finds the voxel data of a raw or PVM input, its size and its voxel spacing
+	bool openInput(const char *path, const glm::ivec3 &rawDimensions, const glm::vec3 &rawSpacing, FILE *&file, uint64_t &dataOffset,
+		glm::ivec3 &dim, glm::vec3 &spacing)
+	{
+		file = fopen(path, "rb");
+		if (!file)
+			return false;
+
+		char magic[8] = { 0 };
+		size_t read = fread(magic, 1, 5, file);
+		if (read >= 4 && strncmp(magic, "DDS ", 4) == 0)
+		{
+			std::cout << "ERROR::BRICKFILE " << path << " is a DDS compressed PVM, it has to be expanded first" << std::endl;
+			fclose(file);
+			return false;
+		}
+		if (read >= 4 && strncmp(magic, "PVM", 3) == 0)
+		{
+			// PVM: magic line, dimensions, (PVM2/3) voxel spacing, components per voxel
+			seek64(file, 0);
+			char line[256];
+			std::string version = fgets(line, sizeof(line), file) ? line : "";
+			int components = 1;
+			bool ok = fscanf(file, "%d %d %d", &dim.x, &dim.y, &dim.z) == 3;
+			spacing = glm::vec3(1.0f);
+			if (version.compare(0, 4, "PVM\n") != 0)
+				ok = ok && fscanf(file, "%f %f %f", &spacing.x, &spacing.y, &spacing.z) == 3 && spacing.x > 0.0f && spacing.y > 0.0f && spacing.z > 0.0f;
+			ok = ok && fscanf(file, "%d", &components) == 1 && fgetc(file) == '\n';
+			if (!ok || components != 1)
+			{
+				std::cout << "ERROR::BRICKFILE Unsupported PVM " << path << std::endl;
+				fclose(file);
+				return false;
+			}
+			dataOffset = tell64(file);
+			return true;
+		}
+
+		dim = rawDimensions;
+		spacing = rawSpacing;
+		dataOffset = 0;
+		return true;
+	}
+
+	// Writes all the bricks of one level, the input is read one slab of
+	// bricks (plus apron slices) at a time. If next is not NULL the next level
+	// is written into it slice by slice
+	bool convertLevel(FILE *in, uint64_t dataOffset, const glm::ivec3 &dim, const glm::ivec3 &nextDim, int brickSize, bool compress,
+		FILE *out, BrickFileEntry *entries, FILE *next)
+	{
+		int stored = brickSize + 2;
+		size_t sliceSize = size_t(dim.x) * dim.y;
+		glm::ivec3 count = (dim + brickSize - 1) / brickSize;
+		std::vector<unsigned char> slab(sliceSize * stored);
+		std::vector<std::vector<unsigned char> > payloads(size_t(count.x) * count.y);
+		std::vector<BrickFileEntry> slabEntries(payloads.size());
+		std::vector<std::vector<FilterTap> > tapsX, tapsY, tapsZ;
+		if (next)
+		{
+			tapsX = boxFilterTaps(dim.x, nextDim.x);
+			tapsY = boxFilterTaps(dim.y, nextDim.y);
+			tapsZ = boxFilterTaps(dim.z, nextDim.z);
+		}
+
+		for (int bz = 0; bz < count.z; bz++)
+		{
+			int firstSlice = bz * brickSize - 1;
+			for (int k = 0; k < stored; k++)
+			{
+				int z = std::min(std::max(firstSlice + k, 0), dim.z - 1);
+				if (!seek64(in, dataOffset + uint64_t(z) * sliceSize) ||
+					fread(&slab[k * sliceSize], 1, sliceSize, in) != sliceSize)
+					return false;
+			}
+
+			parallelFor(0, int(payloads.size()), [&](int first, int last) {
+				std::vector<unsigned char> brick(size_t(stored) * stored * stored);
+				for (int b = first; b < last; b++)
+				{
+					glm::ivec2 origin = glm::ivec2(b % count.x, b / count.x) * brickSize - 1;
+					unsigned char *voxel = brick.data();
+					for (int z = 0; z < stored; z++)
+						for (int y = 0; y < stored; y++)
+						{
+							const unsigned char *row = &slab[z * sliceSize + size_t(std::min(std::max(origin.y + y, 0), dim.y - 1)) * dim.x];
+							for (int x = 0; x < stored; x++)
+								*voxel++ = row[std::min(std::max(origin.x + x, 0), dim.x - 1)];
+						}
+
+					BrickFileEntry &entry = slabEntries[b];
+					memset(&entry, 0, sizeof(entry));
+					entry.minValue = *std::min_element(brick.begin(), brick.end());
+					entry.maxValue = *std::max_element(brick.begin(), brick.end());
+
+					payloads[b].clear();
+					if (compress)
+						rleCompress(brick.data(), brick.size(), payloads[b]);
+					entry.compressed = compress && payloads[b].size() < brick.size();
+					if (!entry.compressed)
+						payloads[b] = brick;
+					entry.size = uint32_t(payloads[b].size());
+				}
+			});
+
+			// Written in index order so the file can be read front to back
+			for (size_t b = 0; b < payloads.size(); b++)
+			{
+				slabEntries[b].offset = tell64(out);
+				if (fwrite(payloads[b].data(), 1, payloads[b].size(), out) != payloads[b].size())
+					return false;
+				entries[size_t(bz) * payloads.size() + b] = slabEntries[b];
+			}
+
+			if (!next)
+				continue;
+
+			// Box filter of the slices of this slab, same as Volume::downsample. Coarse
+			// slice cz covers fine slices 2cz - 1 to 2cz + 1 at most, the apron
+			// slices of the slab hold them
+			std::vector<unsigned char> coarse(size_t(nextDim.x) * nextDim.y);
+			auto fetch = [&](int x, int y, int z) { return slab[(z - firstSlice) * sliceSize + size_t(y) * dim.x + x]; };
+			int firstCoarse = bz * brickSize / 2;
+			int lastCoarse = std::min((bz + 1) * brickSize / 2, nextDim.z);
+			for (int cz = firstCoarse; cz < lastCoarse; cz++)
+			{
+				unsigned char *out = coarse.data();
+				for (int cy = 0; cy < nextDim.y; cy++)
+					for (int cx = 0; cx < nextDim.x; cx++)
+						*out++ = boxFilter(tapsX[cx], tapsY[cy], tapsZ[cz], fetch);
+				if (fwrite(coarse.data(), 1, coarse.size(), next) != coarse.size())
+					return false;
+			}
+		}
+		return true;
+	}
+}
+
+bool convertToBrickFile(const char *inputPath, const glm::ivec3 &rawDimensions, const glm::vec3 &rawSpacing, const char *outputPath, int brickSize, bool compress)
+{
+	FILE *in;
+	uint64_t dataOffset;
+	BrickFileHeader header;
+	memset(&header, 0, sizeof(header));
+	glm::ivec3 dim;
+	glm::vec3 spacing;
+	if (!openInput(inputPath, rawDimensions, rawSpacing, in, dataOffset, dim, spacing))
+		return false;
+
+	std::vector<glm::ivec3> levels = levelDimensions(dim, brickSize);
+	std::vector<int> firstBrick;
+	int bricks = 0;
+	for (const glm::ivec3 &level : levels)
+	{
+		firstBrick.push_back(bricks);
+		glm::ivec3 count = (level + brickSize - 1) / brickSize;
+		bricks += count.x * count.y * count.z;
+	}
+
+	memcpy(header.magic, "BVOL", 4);
+	header.version = brickFileVersion;
+	header.dim[0] = dim.x;
+	header.dim[1] = dim.y;
+	header.dim[2] = dim.z;
+	header.brickSize = brickSize;
+	header.levelCount = int32_t(levels.size());
+	header.brickCount = bricks;
+	header.spacing[0] = spacing.x;
+	header.spacing[1] = spacing.y;
+	header.spacing[2] = spacing.z;
+	header.indexOffset = sizeof(BrickFileHeader);
+
+	FILE *out = fopen(outputPath, "wb");
+	if (!out)
+	{
+		fclose(in);
+		return false;
+	}
+
+	// The index is written last, when the payload offsets are known
+	std::vector<BrickFileEntry> entries(bricks);
+	bool ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+		fwrite(entries.data(), sizeof(BrickFileEntry), entries.size(), out) == entries.size();
+
+	for (size_t level = 0; ok && level < levels.size(); level++)
+	{
+		FILE *next = level + 1 < levels.size() ? tmpfile() : NULL;
+		glm::ivec3 nextDim = level + 1 < levels.size() ? levels[level + 1] : glm::ivec3(0);
+		ok = (next || level + 1 == levels.size()) &&
+			convertLevel(in, dataOffset, levels[level], nextDim, brickSize, compress, out, &entries[firstBrick[level]], next);
+		std::cout << "nivel " << level << " convertido" << std::endl;
+
+		fclose(in);
+		in = next;
+		dataOffset = 0;
+	}
+	if (in)
+		fclose(in);
+
+	ok = ok && seek64(out, header.indexOffset) &&
+		fwrite(entries.data(), sizeof(BrickFileEntry), entries.size(), out) == entries.size();
+	fclose(out);
+	return ok;
+}
+
+BrickFileSource::BrickFileSource() : entries(NULL), mappedView(NULL), mappedLength(0)
+{
+	memset(&header, 0, sizeof(header));
+#ifdef _WIN32
+	file = INVALID_HANDLE_VALUE;
+	mapping = NULL;
+#else
+	file = -1;
+#endif
+}
+
+BrickFileSource::~BrickFileSource()
+{
+	close();
+}
+
+bool BrickFileSource::open(const char *path)
+{
+	close();
+
+#ifdef _WIN32
+	file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	DWORD read = 0;
+	if (!ReadFile(file, &header, sizeof(header), &read, NULL) || read != sizeof(header))
+	{
+		close();
+		return false;
+	}
+#else
+	file = ::open(path, O_RDONLY);
+	if (file < 0)
+		return false;
+	if (pread(file, &header, sizeof(header), 0) != ssize_t(sizeof(header)))
+	{
+		close();
+		return false;
+	}
+#endif
+
+	if (memcmp(header.magic, "BVOL", 4) != 0 || header.version != brickFileVersion || header.brickSize <= 0)
+	{
+		std::cout << "ERROR::BRICKFILE " << path << " is not a brick file" << std::endl;
+		close();
+		return false;
+	}
+
+	// Only the header and the index are mapped, bricks are read on demand
+	mappedLength = size_t(header.indexOffset + uint64_t(header.brickCount) * sizeof(BrickFileEntry));
+#ifdef _WIN32
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	mappedView = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, mappedLength) : NULL;
+#else
+	mappedView = mmap(NULL, mappedLength, PROT_READ, MAP_SHARED, file, 0);
+	if (mappedView == MAP_FAILED)
+		mappedView = NULL;
+#endif
+	if (!mappedView)
+	{
+		close();
+		return false;
+	}
+	entries = (const BrickFileEntry *)((const char *)mappedView + header.indexOffset);
+
+	levels = levelDimensions(glm::ivec3(header.dim[0], header.dim[1], header.dim[2]), header.brickSize);
+	levelFirstBrick.clear();
+	int bricks = 0;
+	for (int level = 0; level < int(levels.size()); level++)
+	{
+		levelFirstBrick.push_back(bricks);
+		glm::ivec3 count = brickCount(level);
+		bricks += count.x * count.y * count.z;
+	}
+	if (int(levels.size()) != header.levelCount || bricks != header.brickCount)
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+void BrickFileSource::close()
+{
+#ifdef _WIN32
+	if (mappedView)
+		UnmapViewOfFile(mappedView);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+	mapping = NULL;
+	file = INVALID_HANDLE_VALUE;
+#else
+	if (mappedView)
+		munmap(mappedView, mappedLength);
+	if (file >= 0)
+		::close(file);
+	file = -1;
+#endif
+	mappedView = NULL;
+	entries = NULL;
+	levels.clear();
+}
+
+int BrickFileSource::levelCount() const
+{
+	return int(levels.size());
+}
+
+glm::ivec3 BrickFileSource::levelDim(int level) const
+{
+	return levels[level];
+}
+
+int BrickFileSource::brickSize() const
+{
+	return header.brickSize;
+}
+
+const BrickFileEntry &BrickFileSource::entry(int level, const glm::ivec3 &brick) const
+{
+	glm::ivec3 count = brickCount(level);
+	return entries[levelFirstBrick[level] + (brick.z * count.y + brick.y) * count.x + brick.x];
+}
+
+glm::vec3 BrickFileSource::spacing() const
+{
+	return glm::vec3(header.spacing[0], header.spacing[1], header.spacing[2]);
+}
+
+bool BrickFileSource::readBrick(int level, const glm::ivec3 &brick, unsigned char *out)
+{
+	const BrickFileEntry &brickEntry = entry(level, brick);
+	size_t stored = size_t(header.brickSize + 2);
+	size_t brickBytes = stored * stored * stored;
+
+	std::vector<unsigned char> compressed;
+	unsigned char *destination = out;
+	if (brickEntry.compressed)
+	{
+		compressed.resize(brickEntry.size);
+		destination = compressed.data();
+	}
+	else if (brickEntry.size != brickBytes)
+		return false;
+
+#ifdef _WIN32
+	OVERLAPPED position;
+	memset(&position, 0, sizeof(position));
+	position.Offset = DWORD(brickEntry.offset & 0xFFFFFFFFu);
+	position.OffsetHigh = DWORD(brickEntry.offset >> 32);
+	DWORD read = 0;
+	if (!ReadFile(file, destination, brickEntry.size, &read, &position) || read != brickEntry.size)
+		return false;
+#else
+	if (pread(file, destination, brickEntry.size, off_t(brickEntry.offset)) != ssize_t(brickEntry.size))
+		return false;
+#endif
+
+	if (brickEntry.compressed)
+		return rleDecompress(compressed.data(), compressed.size(), out, brickBytes);
+	return true;
+}
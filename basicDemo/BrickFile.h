@@ -0,0 +1,131 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "BrickSource.h"
+
+#ifdef _WIN32
+typedef void *FileHandle;
+#else
+typedef int FileHandle;
+#endif
+
+// Out of core multi-resolution volume file (.bvol). A header, an index with
+// one entry per brick and the brick payloads. Bricks are numbered like
+// VirtualVolume::brickIndex (level by level, x-fastest) and every payload is
+// a whole brick with its apron, optionally run length encoded, so any
+// (level, x, y, z) is a single positional read
+struct BrickFileHeader
+{
+	// "BVOL"
+	char magic[4];
+	// Format version
+	uint32_t version;
+	// Level 0 voxels per axis
+	int32_t dim[3];
+	// Voxels per brick side, without the apron
+	int32_t brickSize;
+	// Number of resolution levels
+	int32_t levelCount;
+	// Number of bricks of all the levels
+	int32_t brickCount;
+	// Level 0 voxel spacing per axis
+	float spacing[3];
+	// Position of the index in the file
+	uint64_t indexOffset;
+};
+
+// Index entry of a brick
+struct BrickFileEntry
+{
+	// Position of the payload in the file
+	uint64_t offset;
+	// Stored bytes of the payload
+	uint32_t size;
+	// The payload is run length encoded
+	uint8_t compressed;
+	// Value range of the brick (apron included)
+	uint8_t minValue;
+	uint8_t maxValue;
+	uint8_t reserved;
+};
+
+/**
+* Converts a raw or an uncompressed PVM volume into a brick file. The input is
+* read one slab of bricks at a time and the coarser levels go through
+* temporary files, so the whole volume is never held in memory. The bricks of
+* a slab are extracted and compressed in parallel
+* @param{const char*} input path (.raw or .pvm)
+* @param{glm::ivec3 &} voxels per axis of a raw input (ignored for PVM)
+* @param{glm::vec3 &} voxel spacing of a raw input (ignored for PVM)
+* @param{const char*} output path
+* @param{int} voxels per brick side
+* @param{bool} run length encode the bricks that get smaller with it
+* @returns{bool} true if the file could be written
+*/
+bool convertToBrickFile(const char *inputPath, const glm::ivec3 &rawDimensions, const glm::vec3 &rawSpacing, const char *outputPath, int brickSize, bool compress);
+
+// Brick source that reads a brick file on demand. The index is memory mapped
+// and bricks are read with positional reads (pread / overlapped ReadFile),
+// so the loader threads never share a file position
+class BrickFileSource : public BrickSource
+{
+public:
+	/**
+	* Creates a closed source
+	*/
+	BrickFileSource();
+
+	/**
+	* Closes the file
+	*/
+	~BrickFileSource();
+
+	/**
+	* Opens a brick file and maps its index
+	* @param{const char*} path of the file
+	* @returns{bool} true if the file is a valid brick file
+	*/
+	bool open(const char *path);
+
+	/**
+	* Unmaps the index and closes the file
+	*/
+	void close();
+
+	int levelCount() const override;
+	glm::ivec3 levelDim(int level) const override;
+	int brickSize() const override;
+	bool readBrick(int level, const glm::ivec3 &brick, unsigned char *out) override;
+
+	/**
+	* Index entry of a brick
+	* @param{int} level
+	* @param{glm::ivec3 &} brick coordinates in the level
+	* @returns{BrickFileEntry &} entry
+	*/
+	const BrickFileEntry &entry(int level, const glm::ivec3 &brick) const;
+
+	/**
+	* Voxel spacing of level 0
+	* @returns{glm::vec3} distance between voxel centers per axis
+	*/
+	glm::vec3 spacing() const;
+
+private:
+	BrickFileHeader header;
+	// Mapped index
+	const BrickFileEntry *entries;
+	// Voxels per axis of every level
+	std::vector<glm::ivec3> levels;
+	// First brick of every level
+	std::vector<int> levelFirstBrick;
+
+	FileHandle file;
+#ifdef _WIN32
+	void *mapping;
+#endif
+	// Start and length of the mapped part of the file
+	void *mappedView;
+	size_t mappedLength;
+};
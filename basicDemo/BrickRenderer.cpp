@@ -0,0 +1,240 @@
+#include "BrickRenderer.h"
+#include "MacrocellGrid.h"
+#include "OcclusionPyramid.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace
+{
+	/**
+	* Stable LSD radix sort of 32 bit keys, 8 bits per pass, the values follow their keys
+	* @param{std::vector<uint32_t> &} keys, sorted in place
+	* @param{std::vector<uint32_t> &} values, reordered in place
+	* @param{std::vector<uint32_t> &} scratch keys (resized)
+	* @param{std::vector<uint32_t> &} scratch values (resized)
+	*/
+	void radixSort(std::vector<uint32_t> &keys, std::vector<uint32_t> &values, std::vector<uint32_t> &scratchKeys, std::vector<uint32_t> &scratchValues)
+	{
+		size_t count = keys.size();
+		scratchKeys.resize(count);
+		scratchValues.resize(count);
+		for (int shift = 0; shift < 32; shift += 8)
+		{
+			size_t offsets[256] = {};
+			for (size_t i = 0; i < count; i++)
+				offsets[(keys[i] >> shift) & 0xFF]++;
+			// All the keys share the digit, the pass would copy them in the same order
+			if (count && offsets[(keys[0] >> shift) & 0xFF] == count)
+				continue;
+
+			size_t start = 0;
+			for (int digit = 0; digit < 256; digit++)
+			{
+				size_t bucket = offsets[digit];
+				offsets[digit] = start;
+				start += bucket;
+			}
+			for (size_t i = 0; i < count; i++)
+			{
+				size_t target = offsets[(keys[i] >> shift) & 0xFF]++;
+				scratchKeys[target] = keys[i];
+				scratchValues[target] = values[i];
+			}
+			keys.swap(scratchKeys);
+			values.swap(scratchValues);
+		}
+	}
+
+	/**
+	* Tests the screen rectangle and nearest depth of a box against the occluders
+	* @param{glm::mat4 &} projection * view * model
+	* @param{glm::vec3 &} lower corner of the box (model space)
+	* @param{glm::vec3 &} upper corner of the box (model space)
+	* @param{OcclusionPyramid &} occluders of the previous frame
+	* @returns{bool} true if the box is hidden
+	*/
+	bool occluded(const glm::mat4 &modelViewProjection, const glm::vec3 &boxMin, const glm::vec3 &boxMax, const OcclusionPyramid &occlusion)
+	{
+		if (!occlusion.valid)
+			return false;
+		glm::vec2 first(1e30f), last(-1e30f);
+		float depth = 1.0f;
+		for (int corner = 0; corner < 8; corner++)
+		{
+			glm::vec3 p((corner & 1) ? boxMax.x : boxMin.x, (corner & 2) ? boxMax.y : boxMin.y, (corner & 4) ? boxMax.z : boxMin.z);
+			glm::vec4 clip = modelViewProjection * glm::vec4(p, 1.0f);
+			// Crosses the near plane, the eye is too close to tell
+			if (clip.w <= 1e-6f)
+				return false;
+			glm::vec3 ndc = glm::vec3(clip) / clip.w;
+			glm::vec2 window = (glm::vec2(ndc) * 0.5f + 0.5f) * glm::vec2(occlusion.size);
+			first = glm::min(first, window);
+			last = glm::max(last, window);
+			depth = std::min(depth, ndc.z * 0.5f + 0.5f);
+		}
+		return occlusion.occluded(first, last, depth);
+	}
+}
+
+BrickRenderer::BrickRenderer() : brickCount(0), drawCount(0), vao(0), instanceVBO(0), dirty(true), cropFirst(0.0f), cropLast(1.0f)
+{
+	resetStatistics();
+}
+
+void BrickRenderer::create(unsigned int cubeVBO)
+{
+	if (!vao)
+	{
+		glGenVertexArrays(1, &vao);
+		glGenBuffers(1, &instanceVBO);
+	}
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+
+	// One box per instance
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Instance), (void *)offsetof(Instance, first));
+	glVertexAttribDivisor(1, 1);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Instance), (void *)offsetof(Instance, last));
+	glVertexAttribDivisor(2, 1);
+	glBindVertexArray(0);
+}
+
+void BrickRenderer::markDirty()
+{
+	dirty = true;
+}
+
+bool BrickRenderer::update(const MacrocellGrid &macrocells, const glm::ivec3 &volumeDim, int brickVoxels, const std::vector<unsigned char> &visible,
+	const glm::vec3 &cropFirst, const glm::vec3 &cropLast)
+{
+	if (!dirty && visible == this->visible && cropFirst == this->cropFirst && cropLast == this->cropLast)
+		return false;
+	this->visible = visible;
+	this->cropFirst = cropFirst;
+	this->cropLast = cropLast;
+	dirty = false;
+
+	// A brick is occupied if any of its macrocells is
+	int cellsPerBrick = std::max(1, brickVoxels / std::max(macrocells.cellSize, 1));
+	glm::ivec3 count = macrocells.count;
+	glm::ivec3 brickGrid = (count + cellsPerBrick - 1) / cellsPerBrick;
+	glm::vec3 dim(volumeDim);
+	std::vector<unsigned char> occupied = macrocells.occupiedCells(visible, cropFirst * dim, cropLast * dim);
+	std::vector<unsigned char> brickOccupied(size_t(brickGrid.x) * brickGrid.y * brickGrid.z, 0);
+	for (int z = 0; z < count.z; z++)
+		for (int y = 0; y < count.y; y++)
+			for (int x = 0; x < count.x; x++)
+				if (occupied[(size_t(z) * count.y + y) * count.x + x])
+				{
+					glm::ivec3 brick = glm::ivec3(x, y, z) / cellsPerBrick;
+					brickOccupied[(size_t(brick.z) * brickGrid.y + brick.y) * brickGrid.x + brick.x] = 1;
+				}
+
+	// The last bricks can be partial and the crop box cuts the bricks on its faces
+	glm::vec3 brickExtent = glm::vec3(float(cellsPerBrick * macrocells.cellSize)) / dim;
+	bricks.clear();
+	centers.clear();
+	for (int z = 0; z < brickGrid.z; z++)
+		for (int y = 0; y < brickGrid.y; y++)
+			for (int x = 0; x < brickGrid.x; x++)
+				if (brickOccupied[(size_t(z) * brickGrid.y + y) * brickGrid.x + x])
+				{
+					glm::vec3 brick(x, y, z);
+					Instance instance = { glm::clamp(brick * brickExtent, cropFirst, cropLast), glm::clamp((brick + 1.0f) * brickExtent, cropFirst, cropLast) };
+					bricks.push_back(instance);
+					centers.push_back((brick + 0.5f) * brickExtent);
+				}
+	brickCount = int(bricks.size());
+	return true;
+}
+
+int BrickRenderer::prepare(const glm::mat4 &modelViewProjection, const glm::vec3 &eye, const glm::vec3 &extent, const OcclusionPyramid *occlusion)
+{
+	// Frustum planes in model space (Gribb/Hartmann), a point is inside if dot(plane, p) >= 0 for all
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+		rows[i] = glm::vec4(modelViewProjection[0][i], modelViewProjection[1][i], modelViewProjection[2][i], modelViewProjection[3][i]);
+	glm::vec4 planes[6] = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[3] + rows[2], rows[3] - rows[2] };
+
+	keys.clear();
+	order.clear();
+	for (size_t i = 0; i < bricks.size(); i++)
+	{
+		// Model space box, the cube is the texture space box shifted by -0.5
+		glm::vec3 boxMin = bricks[i].first - 0.5f;
+		glm::vec3 boxMax = bricks[i].last - 0.5f;
+		bool inside = true;
+		for (int p = 0; p < 6 && inside; p++)
+		{
+			// Corner of the box farthest along the plane normal
+			glm::vec3 corner = glm::mix(boxMin, boxMax, glm::vec3(glm::greaterThanEqual(glm::vec3(planes[p]), glm::vec3(0.0f))));
+			inside = glm::dot(glm::vec3(planes[p]), corner) + planes[p].w >= 0.0f;
+		}
+		if (!inside)
+		{
+			statistics.frustumCulled++;
+			continue;
+		}
+		if (occlusion && occluded(modelViewProjection, boxMin, boxMax, *occlusion))
+		{
+			statistics.occlusionCulled++;
+			continue;
+		}
+
+		// The bricks form a regular grid, the distance of their centers to the eye is a visibility order
+		// (the center of a whole brick, the partial and cut ones would break the grid).
+		// Positive floats keep their order as unsigned integers. A non uniform scale
+		// changes the order, the distance is measured in the volume box
+		glm::vec3 offset = (centers[i] - eye) * extent;
+		float distance = glm::dot(offset, offset);
+		uint32_t key;
+		std::memcpy(&key, &distance, sizeof(key));
+		keys.push_back(key);
+		order.push_back(uint32_t(i));
+	}
+	radixSort(keys, order, scratchKeys, scratchOrder);
+
+	sorted.resize(order.size());
+	for (size_t i = 0; i < order.size(); i++)
+		sorted[i] = bricks[order[i]];
+	drawCount = int(sorted.size());
+	statistics.frames++;
+	statistics.drawn += drawCount;
+
+	// Orphans the previous frame's buffer instead of waiting for it
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, sorted.size() * sizeof(Instance), NULL, GL_STREAM_DRAW);
+	if (drawCount)
+		glBufferSubData(GL_ARRAY_BUFFER, 0, sorted.size() * sizeof(Instance), sorted.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return drawCount;
+}
+
+void BrickRenderer::draw() const
+{
+	if (!drawCount)
+		return;
+	glBindVertexArray(vao);
+	glDrawArraysInstanced(GL_TRIANGLES, 0, 36, drawCount);
+	glBindVertexArray(0);
+}
+
+void BrickRenderer::resetStatistics()
+{
+	statistics.frames = statistics.drawn = statistics.frustumCulled = statistics.occlusionCulled = 0;
+}
+
+void BrickRenderer::release()
+{
+	glDeleteVertexArrays(1, &vao);
+	glDeleteBuffers(1, &instanceVBO);
+	vao = instanceVBO = 0;
+	drawCount = 0;
+}
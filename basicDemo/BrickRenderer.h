@@ -0,0 +1,106 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+class MacrocellGrid;
+class OcclusionPyramid;
+
+// Alternative to the single ray through the cube: the occupied bricks are
+// drawn one instance each, sorted front to back, and every fragment marches
+// only inside its own brick. The rays composite across bricks with the under
+// operator (GL_ONE_MINUS_DST_ALPHA), so a brick can be culled as a whole
+class BrickRenderer
+{
+public:
+	/**
+	* Creates an empty brick list
+	*/
+	BrickRenderer();
+
+	/**
+	* Creates the vertex array, the cube is shared and the bricks are instances
+	* @param{unsigned int} vertex buffer of the unit cube (36 vertices, model space [-0.5, 0.5])
+	*/
+	void create(unsigned int cubeVBO);
+
+	/**
+	* The min/max grid changed, the next update lists the bricks again
+	*/
+	void markDirty();
+
+	/**
+	* Groups the macrocells into bricks and keeps the occupied ones, cut to the crop
+	* box, only if the densities that matter, the crop box or the min/max grid changed
+	* @param{MacrocellGrid &} min/max grid
+	* @param{glm::ivec3 &} voxels per axis of the volume
+	* @param{int} voxels per brick side, rounded to whole macrocells
+	* @param{std::vector<unsigned char> &} densities (256 entries) that can change a ray
+	* @param{glm::vec3 &} lower corner of the crop box (texture space)
+	* @param{glm::vec3 &} upper corner of the crop box (texture space)
+	* @returns{bool} true if the bricks were listed again
+	*/
+	bool update(const MacrocellGrid &macrocells, const glm::ivec3 &volumeDim, int brickVoxels, const std::vector<unsigned char> &visible,
+		const glm::vec3 &cropFirst, const glm::vec3 &cropLast);
+
+	/**
+	* Culls the bricks outside the view frustum or behind the occluders of the
+	* previous frame, sorts the rest front to back and uploads them
+	* @param{glm::mat4 &} projection * view * model
+	* @param{glm::vec3 &} eye position in texture space (the cube spans [0, 1])
+	* @param{glm::vec3 &} size of the volume box, the eye distances are measured in it
+	* @param{OcclusionPyramid *} occluders of the previous frame, NULL to draw every brick in the frustum
+	* @returns{int} bricks to draw
+	*/
+	int prepare(const glm::mat4 &modelViewProjection, const glm::vec3 &eye, const glm::vec3 &extent, const OcclusionPyramid *occlusion = NULL);
+
+	/**
+	* Draws the bricks of the last prepare in a single instanced call
+	*/
+	void draw() const;
+
+	/**
+	* Deletes the GPU objects
+	*/
+	void release();
+
+	/**
+	* Starts counting the culled bricks again
+	*/
+	void resetStatistics();
+
+	// Bricks of every prepare since the last reset
+	struct Statistics
+	{
+		uint64_t frames;
+		uint64_t drawn;
+		uint64_t frustumCulled;
+		uint64_t occlusionCulled;
+	};
+
+	// Occupied bricks
+	int brickCount;
+	// Bricks of the last prepare
+	int drawCount;
+	Statistics statistics;
+
+private:
+	// Box of a brick in texture space
+	struct Instance
+	{
+		glm::vec3 first;
+		glm::vec3 last;
+	};
+
+	unsigned int vao, instanceVBO;
+	bool dirty;
+	// Densities and crop box of the last update
+	std::vector<unsigned char> visible;
+	glm::vec3 cropFirst, cropLast;
+	std::vector<Instance> bricks;
+	// Center of the whole brick of every instance, the sort key
+	std::vector<glm::vec3> centers;
+	// Per frame sort buffers (squared eye distance bits and brick index)
+	std::vector<uint32_t> keys, order, scratchKeys, scratchOrder;
+	std::vector<Instance> sorted;
+};
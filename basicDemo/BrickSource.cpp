@@ -0,0 +1,50 @@
+#include "BrickSource.h"
+#include <algorithm>
+
+std::vector<glm::ivec3> levelDimensions(const glm::ivec3 &dim, int brickSize)
+{
+	std::vector<glm::ivec3> dims(1, dim);
+	while (glm::any(glm::greaterThan(dims.back(), glm::ivec3(brickSize))))
+		dims.push_back(glm::max((dims.back() + 1) / 2, glm::ivec3(1)));
+	return dims;
+}
+
+MemoryBrickSource::MemoryBrickSource(const Volume &volume, int brickSize) : fullResolution(volume), size(brickSize)
+{
+	std::vector<glm::ivec3> dims = levelDimensions(volume.dim, size);
+	for (size_t l = 1; l < dims.size(); l++)
+		coarseLevels.push_back(level(levelCount() - 1).downsample(dims[l]));
+}
+
+int MemoryBrickSource::levelCount() const
+{
+	return int(coarseLevels.size()) + 1;
+}
+
+glm::ivec3 MemoryBrickSource::levelDim(int level) const
+{
+	return this->level(level).dim;
+}
+
+int MemoryBrickSource::brickSize() const
+{
+	return size;
+}
+
+bool MemoryBrickSource::readBrick(int level, const glm::ivec3 &brick, unsigned char *out)
+{
+	const Volume &source = this->level(level);
+	glm::ivec3 origin = brick * size - 1;
+	int stored = size + 2;
+
+	for (int z = 0; z < stored; z++)
+		for (int y = 0; y < stored; y++)
+			for (int x = 0; x < stored; x++)
+				*out++ = source.voxel(origin.x + x, origin.y + y, origin.z + z);
+	return true;
+}
+
+const Volume &MemoryBrickSource::level(int level) const
+{
+	return level == 0 ? fullResolution : coarseLevels[level - 1];
+}
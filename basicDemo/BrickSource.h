@@ -0,0 +1,96 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "Volume.h"
+
+/**
+* Voxels per axis of every resolution level, each level halves the previous
+* one (rounding up) until a single brick covers it
+* @param{glm::ivec3 &} level 0 voxels per axis
+* @param{int} voxels per brick side
+* @returns{std::vector<glm::ivec3>} size of every level, level 0 first
+*/
+std::vector<glm::ivec3> levelDimensions(const glm::ivec3 &dim, int brickSize);
+
+// Provides the bricks of a multi-resolution volume. Level 0 is the full
+// resolution, every following level halves the previous one. A brick holds
+// brickSize^3 voxels plus a one voxel apron on every side, so it can be
+// filtered on its own in the brick atlas
+class BrickSource
+{
+public:
+	virtual ~BrickSource() {}
+
+	/**
+	* Number of resolution levels
+	* @returns{int} level count
+	*/
+	virtual int levelCount() const = 0;
+
+	/**
+	* Voxels per axis of a level
+	* @param{int} level
+	* @returns{glm::ivec3} level size
+	*/
+	virtual glm::ivec3 levelDim(int level) const = 0;
+
+	/**
+	* Voxels per brick side, without the apron
+	* @returns{int} brick size
+	*/
+	virtual int brickSize() const = 0;
+
+	/**
+	* Copies a brick with its apron, (brickSize + 2)^3 voxels x-fastest.
+	* Must be safe to call from several threads at once
+	* @param{int} level
+	* @param{glm::ivec3 &} brick coordinates in the level
+	* @param{unsigned char *} destination
+	* @returns{bool} true if the brick could be read
+	*/
+	virtual bool readBrick(int level, const glm::ivec3 &brick, unsigned char *out) = 0;
+
+	/**
+	* Bricks per axis of a level
+	* @param{int} level
+	* @returns{glm::ivec3} brick count
+	*/
+	glm::ivec3 brickCount(int level) const
+	{
+		return (levelDim(level) + brickSize() - 1) / brickSize();
+	}
+};
+
+// Brick source backed by a volume in main memory, the coarser levels are
+// box filtered from it until a single brick covers the whole volume.
+// The volume is referenced, not copied, it has to outlive the source
+class MemoryBrickSource : public BrickSource
+{
+public:
+	/**
+	* Builds the resolution levels of a volume
+	* @param{Volume &} full resolution volume
+	* @param{int} voxels per brick side
+	*/
+	MemoryBrickSource(const Volume &volume, int brickSize);
+
+	int levelCount() const override;
+	glm::ivec3 levelDim(int level) const override;
+	int brickSize() const override;
+	bool readBrick(int level, const glm::ivec3 &brick, unsigned char *out) override;
+
+	/**
+	* Gets the voxels of a level
+	* @param{int} level
+	* @returns{Volume &} level volume
+	*/
+	const Volume &level(int level) const;
+
+private:
+	// Full resolution volume (level 0)
+	const Volume &fullResolution;
+	// Levels 1 and above
+	std::vector<Volume> coarseLevels;
+	// Voxels per brick side
+	int size;
+};
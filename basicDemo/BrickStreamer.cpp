@@ -0,0 +1,185 @@
+#include "BrickStreamer.h"
+#include "VirtualVolume.h"
+#include "BrickSource.h"
+#include <glad/glad.h>
+#include <algorithm>
+
+BrickStreamer::BrickStreamer() : feedbackTextureID(0), virtualVolume(NULL), running(false), currentBuffer(0), previousValid(false), width(0), height(0)
+{
+	pixelBuffers[0] = pixelBuffers[1] = 0;
+}
+
+BrickStreamer::~BrickStreamer()
+{
+	stop();
+}
+
+void BrickStreamer::start(VirtualVolume *virtualVolume)
+{
+	stop();
+	this->virtualVolume = virtualVolume;
+	running = true;
+	loader = std::thread(&BrickStreamer::loaderLoop, this);
+}
+
+void BrickStreamer::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	wake.notify_all();
+	if (loader.joinable())
+		loader.join();
+
+	requests.clear();
+	loaded.clear();
+	pending.clear();
+	previousValid = false;
+}
+
+void BrickStreamer::resize(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+
+	if (!feedbackTextureID)
+		glGenTextures(1, &feedbackTextureID);
+	glBindTexture(GL_TEXTURE_2D, feedbackTextureID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, width, height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+
+	if (!pixelBuffers[0])
+		glGenBuffers(2, pixelBuffers);
+	for (int i = 0; i < 2; i++)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, size_t(width) * height * sizeof(unsigned int), NULL, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	previousValid = false;
+}
+
+void BrickStreamer::readFeedback(int attachment)
+{
+	// Asynchronous copy of this frame
+	glReadBuffer(GL_COLOR_ATTACHMENT0 + attachment);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[currentBuffer]);
+	glReadPixels(0, 0, width, height, GL_RED_INTEGER, GL_UNSIGNED_INT, 0);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+	// The previous frame had a whole frame to arrive
+	int previous = 1 - currentBuffer;
+	currentBuffer = previous;
+	if (!previousValid)
+	{
+		previousValid = true;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		return;
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[previous]);
+	const unsigned int *ids = (const unsigned int *)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+	if (ids)
+	{
+		virtualVolume->nextFrame();
+
+		std::vector<int> missing;
+		unsigned int last = 0;
+		size_t count = size_t(width) * height;
+		for (size_t i = 0; i < count; i++)
+		{
+			// Neighbouring pixels usually ask for the same brick
+			if (ids[i] == 0 || ids[i] == last)
+				continue;
+			last = ids[i];
+			int index = int(ids[i] - 1);
+			if (index >= int(virtualVolume->brickSlot.size()))
+				continue;
+			if (virtualVolume->brickSlot[index] >= 0)
+				virtualVolume->touch(index);
+			else if (pending.insert(index).second)
+				missing.push_back(index);
+		}
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+
+		if (!missing.empty())
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			requests.insert(requests.end(), missing.begin(), missing.end());
+			wake.notify_one();
+		}
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+int BrickStreamer::uploadLoaded(int maxBricks)
+{
+	int uploaded = 0;
+	while (uploaded < maxBricks)
+	{
+		LoadedBrick brick;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (loaded.empty())
+				break;
+			brick = std::move(loaded.front());
+			loaded.pop_front();
+		}
+
+		pending.erase(brick.index);
+		if (!brick.voxels.empty() && virtualVolume->uploadBrick(brick.index, brick.voxels.data()))
+			uploaded++;
+	}
+
+	if (virtualVolume->pageTableDirty)
+		virtualVolume->updatePageTable();
+	return uploaded;
+}
+
+int BrickStreamer::pendingCount() const
+{
+	return int(pending.size());
+}
+
+void BrickStreamer::loaderLoop()
+{
+	BrickSource *source = virtualVolume->source;
+	size_t brickBytes = size_t(virtualVolume->slotSize) * virtualVolume->slotSize * virtualVolume->slotSize;
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		wake.wait(lock, [this] { return !running || !requests.empty(); });
+		if (!running)
+			return;
+
+		int index = requests.front();
+		requests.pop_front();
+		lock.unlock();
+
+		LoadedBrick brick;
+		brick.index = index;
+		brick.voxels.resize(brickBytes);
+		int level;
+		glm::ivec3 coordinates;
+		virtualVolume->brickCoordinates(index, level, coordinates);
+		// A failed read still goes back so the brick can be asked for again
+		if (!source->readBrick(level, coordinates, brick.voxels.data()))
+			brick.voxels.clear();
+
+		lock.lock();
+		loaded.push_back(std::move(brick));
+	}
+}
+
+void BrickStreamer::release()
+{
+	if (feedbackTextureID)
+		glDeleteTextures(1, &feedbackTextureID);
+	if (pixelBuffers[0])
+		glDeleteBuffers(2, pixelBuffers);
+	feedbackTextureID = 0;
+	pixelBuffers[0] = pixelBuffers[1] = 0;
+}
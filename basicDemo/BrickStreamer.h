@@ -0,0 +1,108 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+class VirtualVolume;
+
+// Ray guided brick streaming. The raycaster writes the brick each pixel
+// needs (index + 1, 0 for none) into an R32UI attachment, the buffer is read
+// back through two pixel buffer objects so the CPU only looks at the previous
+// frame and never waits for the GPU. Missing bricks are read by a loader
+// thread and uploaded by the render thread a few per frame
+class BrickStreamer
+{
+public:
+	/**
+	* Creates a stopped streamer
+	*/
+	BrickStreamer();
+
+	/**
+	* Stops the loader thread
+	*/
+	~BrickStreamer();
+
+	/**
+	* Starts the loader thread for a virtual volume
+	* @param{VirtualVolume *} virtual volume, its brick source is read from the loader thread
+	*/
+	void start(VirtualVolume *virtualVolume);
+
+	/**
+	* Stops the loader thread and forgets every pending request
+	*/
+	void stop();
+
+	/**
+	* Creates the feedback texture and the readback buffers
+	* @param{int} width of the render target
+	* @param{int} height of the render target
+	*/
+	void resize(int width, int height);
+
+	/**
+	* Queues the read of the feedback attachment of the bound framebuffer and
+	* processes the one of the previous frame: used bricks are touched and
+	* missing ones are requested to the loader thread
+	* @param{int} color attachment that holds the feedback
+	*/
+	void readFeedback(int attachment);
+
+	/**
+	* Uploads the bricks the loader thread has finished and updates the page table
+	* @param{int} most bricks uploaded in this call
+	* @returns{int} number of bricks uploaded
+	*/
+	int uploadLoaded(int maxBricks);
+
+	/**
+	* Deletes the GPU objects
+	*/
+	void release();
+
+	/**
+	* Bricks requested and not uploaded yet
+	* @returns{int} pending brick count
+	*/
+	int pendingCount() const;
+
+	// Index (GPU) of the R32UI feedback texture
+	unsigned int feedbackTextureID;
+
+private:
+	/**
+	* Loader thread body
+	*/
+	void loaderLoop();
+
+	// Brick read by the loader thread
+	struct LoadedBrick
+	{
+		int index;
+		std::vector<unsigned char> voxels;
+	};
+
+	VirtualVolume *virtualVolume;
+	std::thread loader;
+	mutable std::mutex mutex;
+	std::condition_variable wake;
+	bool running;
+	// Bricks to read (loader thread input)
+	std::deque<int> requests;
+	// Bricks read and waiting to be uploaded (loader thread output)
+	std::deque<LoadedBrick> loaded;
+	// Requested and not uploaded yet, avoids asking for the same brick twice
+	std::unordered_set<int> pending;
+
+	// Readback buffers, one is written while the other is read
+	unsigned int pixelBuffers[2];
+	// Buffer that receives the current frame
+	int currentBuffer;
+	// The other buffer holds a frame that can be processed
+	bool previousValid;
+	int width, height;
+};
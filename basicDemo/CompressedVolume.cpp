@@ -0,0 +1,267 @@
+#include "CompressedVolume.h"
+#include "Volume.h"
+#include "Parallel.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BC4_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Decoded values of a block. red0 > red1 interpolates 6 values between them,
+	// otherwise 4 values are interpolated and the last two entries are 0 and 255
+	void blockPalette(int red0, int red1, unsigned char palette[8])
+	{
+		palette[0] = (unsigned char)red0;
+		palette[1] = (unsigned char)red1;
+		if (red0 > red1)
+		{
+			for (int i = 2; i < 8; i++)
+				palette[i] = (unsigned char)(((8 - i) * red0 + (i - 1) * red1 + 3) / 7);
+		}
+		else
+		{
+			for (int i = 2; i < 6; i++)
+				palette[i] = (unsigned char)(((6 - i) * red0 + (i - 1) * red1 + 2) / 5);
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+#ifdef BC4_SSE2
+	inline unsigned char horizontalMin(__m128i v)
+	{
+		v = _mm_min_epu8(v, _mm_srli_si128(v, 8));
+		v = _mm_min_epu8(v, _mm_srli_si128(v, 4));
+		v = _mm_min_epu8(v, _mm_srli_si128(v, 2));
+		v = _mm_min_epu8(v, _mm_srli_si128(v, 1));
+		return (unsigned char)_mm_cvtsi128_si32(v);
+	}
+
+	inline unsigned char horizontalMax(__m128i v)
+	{
+		v = _mm_max_epu8(v, _mm_srli_si128(v, 8));
+		v = _mm_max_epu8(v, _mm_srli_si128(v, 4));
+		v = _mm_max_epu8(v, _mm_srli_si128(v, 2));
+		v = _mm_max_epu8(v, _mm_srli_si128(v, 1));
+		return (unsigned char)_mm_cvtsi128_si32(v);
+	}
+
+	// Picks the closest palette entry of the 16 texels, returns the squared error
+	int fitIndices(const unsigned char texels[16], const unsigned char palette[8], unsigned char indices[16])
+	{
+		__m128i values = _mm_loadu_si128((const __m128i *)texels);
+		__m128i best = _mm_set1_epi8((char)0xFF);
+		__m128i index = _mm_setzero_si128();
+		for (int i = 0; i < 8; i++)
+		{
+			__m128i entry = _mm_set1_epi8((char)palette[i]);
+			__m128i distance = _mm_or_si128(_mm_subs_epu8(values, entry), _mm_subs_epu8(entry, values));
+			// Unsigned distance < best
+			__m128i closer = _mm_andnot_si128(_mm_cmpeq_epi8(distance, best),
+				_mm_cmpeq_epi8(_mm_min_epu8(distance, best), distance));
+			best = _mm_min_epu8(distance, best);
+			index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi8((char)i)), _mm_andnot_si128(closer, index));
+		}
+		_mm_storeu_si128((__m128i *)indices, index);
+
+		__m128i zero = _mm_setzero_si128();
+		__m128i low = _mm_unpacklo_epi8(best, zero), high = _mm_unpackhi_epi8(best, zero);
+		__m128i squares = _mm_add_epi32(_mm_madd_epi16(low, low), _mm_madd_epi16(high, high));
+		squares = _mm_add_epi32(squares, _mm_srli_si128(squares, 8));
+		squares = _mm_add_epi32(squares, _mm_srli_si128(squares, 4));
+		return _mm_cvtsi128_si32(squares);
+	}
+#else
+	int fitIndices(const unsigned char texels[16], const unsigned char palette[8], unsigned char indices[16])
+	{
+		int error = 0;
+		for (int t = 0; t < 16; t++)
+		{
+			int best = 256;
+			for (int i = 0; i < 8; i++)
+			{
+				int distance = std::abs(int(texels[t]) - int(palette[i]));
+				if (distance < best)
+				{
+					best = distance;
+					indices[t] = (unsigned char)i;
+				}
+			}
+			error += best * best;
+		}
+		return error;
+	}
+#endif
+
+	// Range of the texels, inner ignores the 0 and 255 the second mode has for free
+	void blockRange(const unsigned char texels[16], int &lo, int &hi, int &innerLo, int &innerHi)
+	{
+#ifdef BC4_SSE2
+		__m128i values = _mm_loadu_si128((const __m128i *)texels);
+		__m128i zeros = _mm_cmpeq_epi8(values, _mm_setzero_si128());
+		__m128i full = _mm_cmpeq_epi8(values, _mm_set1_epi8((char)0xFF));
+		lo = horizontalMin(values);
+		hi = horizontalMax(values);
+		innerLo = horizontalMin(_mm_or_si128(values, zeros));
+		innerHi = horizontalMax(_mm_andnot_si128(full, values));
+#else
+		lo = innerLo = 255;
+		hi = innerHi = 0;
+		for (int t = 0; t < 16; t++)
+		{
+			int v = texels[t];
+			lo = std::min(lo, v);
+			hi = std::max(hi, v);
+			if (v != 0)
+				innerLo = std::min(innerLo, v);
+			if (v != 255)
+				innerHi = std::max(innerHi, v);
+		}
+#endif
+	}
+
+	// Encodes one block, returns its squared error
+	int encodeBlock(const unsigned char texels[16], unsigned char *block)
+	{
+		int lo, hi, innerLo, innerHi;
+		blockRange(texels, lo, hi, innerLo, innerHi);
+
+		// Six interpolated values between the extremes
+		unsigned char palette[8], indices[16];
+		int red0 = hi, red1 = lo;
+		blockPalette(red0, red1, palette);
+		int error = fitIndices(texels, palette, indices);
+
+		// Blocks touching 0 or 255 may do better spending the palette on the rest
+		if (error > 0 && (lo == 0 || hi == 255))
+		{
+			int inner0 = std::min(innerLo, innerHi), inner1 = std::max(innerLo, innerHi);
+			unsigned char innerPalette[8], innerIndices[16];
+			blockPalette(inner0, inner1, innerPalette);
+			int innerError = fitIndices(texels, innerPalette, innerIndices);
+			if (innerError < error)
+			{
+				error = innerError;
+				red0 = inner0;
+				red1 = inner1;
+				memcpy(indices, innerIndices, sizeof(indices));
+			}
+		}
+
+		// 16 indices of 3 bits, little endian, texel (x, y) at bit 3 * (4y + x)
+		block[0] = (unsigned char)red0;
+		block[1] = (unsigned char)red1;
+		unsigned long long bits = 0;
+		for (int t = 0; t < 16; t++)
+			bits |= (unsigned long long)indices[t] << (3 * t);
+		for (int b = 0; b < 6; b++)
+			block[2 + b] = (unsigned char)(bits >> (8 * b));
+		return error;
+	}
+}
+
+CompressedVolume::CompressedVolume() : dim(0), blockCount(0), meanSquaredError(0.0), textureID(0)
+{
+}
+
+void CompressedVolume::encode(const Volume &volume)
+{
+	dim = volume.dim;
+	blockCount = (glm::ivec2(dim) + 3) / 4;
+	size_t sliceBlocks = size_t(blockCount.x) * blockCount.y;
+	blocks.resize(sliceBlocks * dim.z * blockBytes);
+	std::vector<double> sliceError(dim.z, 0.0);
+
+	parallelFor(0, dim.z, [&](int first, int last) {
+		unsigned char texels[16];
+		for (int z = first; z < last; z++)
+		{
+			const unsigned char *slice = &volume.data[size_t(z) * dim.x * dim.y];
+			unsigned char *block = &blocks[size_t(z) * sliceBlocks * blockBytes];
+			double error = 0.0;
+			for (int by = 0; by < blockCount.y; by++)
+				for (int bx = 0; bx < blockCount.x; bx++, block += blockBytes)
+				{
+					// Partial blocks at the border repeat the last row/column, they are not counted
+					int texelsX = std::min(4, dim.x - bx * 4), texelsY = std::min(4, dim.y - by * 4);
+					for (int t = 0; t < 16; t++)
+					{
+						int x = bx * 4 + std::min(t & 3, texelsX - 1);
+						int y = by * 4 + std::min(t >> 2, texelsY - 1);
+						texels[t] = slice[size_t(y) * dim.x + x];
+					}
+					int blockError = encodeBlock(texels, block);
+					if (texelsX < 4 || texelsY < 4)
+					{
+						unsigned char decoded[8];
+						blockPalette(block[0], block[1], decoded);
+						unsigned long long bits = 0;
+						for (int b = 0; b < 6; b++)
+							bits |= (unsigned long long)block[2 + b] << (8 * b);
+						blockError = 0;
+						for (int y = 0; y < texelsY; y++)
+							for (int x = 0; x < texelsX; x++)
+							{
+								int t = y * 4 + x;
+								int difference = int(decoded[(bits >> (3 * t)) & 7]) - int(texels[t]);
+								blockError += difference * difference;
+							}
+					}
+					error += blockError;
+				}
+			sliceError[z] = error;
+		}
+	});
+
+	double total = 0.0;
+	for (double error : sliceError)
+		total += error;
+	meanSquaredError = volume.voxelCount() ? total / double(volume.voxelCount()) : 0.0;
+}
+
+bool CompressedVolume::assign(const glm::ivec3 &dim, const unsigned char *data, size_t size, double meanSquaredError)
+{
+	glm::ivec2 count = (glm::ivec2(dim) + 3) / 4;
+	if (size != size_t(count.x) * count.y * dim.z * blockBytes)
+		return false;
+	this->dim = dim;
+	blockCount = count;
+	blocks.assign(data, data + size);
+	this->meanSquaredError = meanSquaredError;
+	return true;
+}
+
+void CompressedVolume::upload()
+{
+	if (!textureID)
+		glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+
+	// Filtering between layers is done in the shader
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+
+	glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_COMPRESSED_RED_RGTC1, dim.x, dim.y, dim.z, 0, GLsizei(blocks.size()), blocks.data());
+}
+
+double CompressedVolume::psnr() const
+{
+	if (meanSquaredError <= 0.0)
+		return std::numeric_limits<double>::infinity();
+	return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+}
+
+size_t CompressedVolume::compressedSize() const
+{
+	return blocks.size();
+}
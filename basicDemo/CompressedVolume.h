@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+class Volume;
+
+// BC4 (RGTC1) compressed copy of a volume, one compressed 2D array layer per
+// Z slice. Every 4x4 texel block takes 8 bytes, half the memory of the 8 bit
+// texture; the raycaster interpolates between the layers itself
+class CompressedVolume
+{
+public:
+	/**
+	* Creates an empty compressed volume
+	*/
+	CompressedVolume();
+
+	/**
+	* Encodes every slice of a volume, slices are split among all the hardware
+	* threads and the blocks are fitted 16 texels at a time with SSE. Each block
+	* tries both BC4 modes and keeps the one with the lower error
+	* @param{Volume &} source volume
+	*/
+	void encode(const Volume &volume);
+
+	/**
+	* Takes blocks encoded by a previous run (the derived data cache)
+	* @param{glm::ivec3 &} voxels per axis
+	* @param{const unsigned char *} blocks, as stored in blocks
+	* @param{size_t} bytes of the blocks
+	* @param{double} mean squared error of the encoding
+	* @returns{bool} false if the size does not match the volume
+	*/
+	bool assign(const glm::ivec3 &dim, const unsigned char *data, size_t size, double meanSquaredError);
+
+	/**
+	* Loads the blocks into the GPU as a GL_COMPRESSED_RED_RGTC1 2D array texture
+	*/
+	void upload();
+
+	/**
+	* Peak signal to noise ratio of the encoded volume against its source
+	* @returns{double} PSNR in dB (infinite for a lossless encoding)
+	*/
+	double psnr() const;
+
+	/**
+	* Bytes taken by the compressed blocks
+	* @returns{size_t} compressed size
+	*/
+	size_t compressedSize() const;
+
+	// Voxels per axis
+	glm::ivec3 dim;
+	// Blocks per slice along x and y
+	glm::ivec2 blockCount;
+	// Compressed blocks, slice by slice, x-fastest
+	std::vector<unsigned char> blocks;
+	// Mean squared error of the encoding, in 8 bit units
+	double meanSquaredError;
+	// Index (GPU) of the 2D array texture
+	unsigned int textureID;
+
+	// Bytes of a compressed 4x4 block
+	static const int blockBytes = 8;
+	// Version of the encoder, part of the derived data cache key
+	static const int version = 1;
+};
@@ -0,0 +1,265 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "DeltaSeries.h"
+#include "Volume.h"
+#include "Parallel.h"
+#include "Storage.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace
+{
+	const uint32_t deltaSeriesVersion = 1;
+
+	// Brick payload: index, bytes and the run length encoded XOR
+	struct BrickRecord
+	{
+		uint32_t brick;
+		uint32_t size;
+	};
+
+	// Copies the voxels of a box, x-fastest, into out
+	void extractBox(const Volume &volume, const glm::ivec3 &origin, const glm::ivec3 &extent, unsigned char *out)
+	{
+		for (int z = 0; z < extent.z; z++)
+			for (int y = 0; y < extent.y; y++)
+			{
+				memcpy(out, &volume.data[(size_t(origin.z + z) * volume.dim.y + origin.y + y) * volume.dim.x + origin.x], extent.x);
+				out += extent.x;
+			}
+	}
+
+	std::string stepPath(const char *pattern, int step)
+	{
+		char path[1024];
+		snprintf(path, sizeof(path), pattern, step);
+		return path;
+	}
+}
+
+bool convertToDeltaSeries(const char *pattern, int count, const glm::ivec3 &dim, const char *outputPath, int brickSize, int keyframeInterval)
+{
+	DeltaSeries layout;
+	layout.dim = dim;
+	layout.brickSize = brickSize;
+	layout.brickCount = (dim + brickSize - 1) / brickSize;
+	int bricks = layout.brickCount.x * layout.brickCount.y * layout.brickCount.z;
+
+	DeltaSeriesHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "BDTS", 4);
+	header.version = deltaSeriesVersion;
+	header.dim[0] = dim.x;
+	header.dim[1] = dim.y;
+	header.dim[2] = dim.z;
+	header.brickSize = brickSize;
+	header.stepCount = count;
+	header.keyframeInterval = std::max(keyframeInterval, 1);
+
+	FILE *out = fopen(outputPath, "wb");
+	if (!out)
+		return false;
+	bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+
+	Volume previous, current;
+	std::vector<DeltaStepEntry> index(count);
+	std::vector<std::vector<unsigned char> > payloads(bricks);
+	uint64_t rawBytes = 0, storedBytes = 0;
+	for (int step = 0; ok && step < count; step++)
+	{
+		if (!current.loadRaw(stepPath(pattern, step).c_str(), dim))
+		{
+			std::cout << "ERROR::DELTASERIES Cannot read " << stepPath(pattern, step) << std::endl;
+			ok = false;
+			break;
+		}
+
+		DeltaStepEntry &entry = index[step];
+		entry.offset = tell64(out);
+		if (step % header.keyframeInterval == 0)
+		{
+			rleCompress(current.data.data(), current.data.size(), payloads[0]);
+			entry.size = uint32_t(payloads[0].size());
+			entry.brickCount = uint32_t(bricks);
+			ok = fwrite(payloads[0].data(), 1, payloads[0].size(), out) == payloads[0].size();
+		}
+		else
+		{
+			// Unchanged bricks get an empty payload
+			parallelFor(0, bricks, [&](int first, int last) {
+				std::vector<unsigned char> before, after;
+				for (int b = first; b < last; b++)
+				{
+					glm::ivec3 origin, extent;
+					layout.brickBox(b, origin, extent);
+					size_t voxels = size_t(extent.x) * extent.y * extent.z;
+					before.resize(voxels);
+					after.resize(voxels);
+					extractBox(previous, origin, extent, before.data());
+					extractBox(current, origin, extent, after.data());
+
+					payloads[b].clear();
+					if (memcmp(before.data(), after.data(), voxels) == 0)
+						continue;
+					for (size_t v = 0; v < voxels; v++)
+						after[v] ^= before[v];
+					rleCompress(after.data(), voxels, payloads[b]);
+				}
+			});
+
+			entry.size = 0;
+			entry.brickCount = 0;
+			for (int b = 0; ok && b < bricks; b++)
+			{
+				if (payloads[b].empty())
+					continue;
+				BrickRecord brick = { uint32_t(b), uint32_t(payloads[b].size()) };
+				ok = fwrite(&brick, sizeof(brick), 1, out) == 1 &&
+					fwrite(payloads[b].data(), 1, payloads[b].size(), out) == payloads[b].size();
+				entry.size += uint32_t(sizeof(brick) + payloads[b].size());
+				entry.brickCount++;
+			}
+		}
+		rawBytes += current.data.size();
+		storedBytes += entry.size;
+		std::cout << "paso " << step << ": " << entry.brickCount << " bricks, " << (entry.size >> 10) << " KB" << std::endl;
+		std::swap(previous, current);
+	}
+
+	header.indexOffset = tell64(out);
+	ok = ok && fwrite(index.data(), sizeof(DeltaStepEntry), index.size(), out) == index.size() &&
+		seek64(out, 0) && fwrite(&header, sizeof(header), 1, out) == 1;
+	fclose(out);
+	if (ok)
+		std::cout << "serie: " << (rawBytes >> 20) << " MB en bruto, " << (storedBytes >> 20) << " MB guardados" << std::endl;
+	return ok;
+}
+
+DeltaSeries::DeltaSeries() : dim(0), brickCount(0), brickSize(0), stepCount(0), keyframeInterval(1), bytesRead(0), file(NULL)
+{
+}
+
+DeltaSeries::~DeltaSeries()
+{
+	close();
+}
+
+bool DeltaSeries::open(const char *path)
+{
+	close();
+	file = fopen(path, "rb");
+	if (!file)
+		return false;
+
+	DeltaSeriesHeader header;
+	if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, "BDTS", 4) != 0 ||
+		header.version != deltaSeriesVersion || header.brickSize <= 0 || header.stepCount <= 0)
+	{
+		std::cout << "ERROR::DELTASERIES " << path << " is not a delta encoded series" << std::endl;
+		close();
+		return false;
+	}
+
+	dim = glm::ivec3(header.dim[0], header.dim[1], header.dim[2]);
+	brickSize = header.brickSize;
+	brickCount = (dim + brickSize - 1) / brickSize;
+	stepCount = header.stepCount;
+	keyframeInterval = std::max(header.keyframeInterval, 1);
+
+	index.resize(stepCount);
+	if (!seek64(file, header.indexOffset) || fread(index.data(), sizeof(DeltaStepEntry), index.size(), file) != index.size())
+	{
+		close();
+		return false;
+	}
+	bytesRead = 0;
+	return true;
+}
+
+void DeltaSeries::close()
+{
+	if (file)
+		fclose(file);
+	file = NULL;
+	index.clear();
+}
+
+bool DeltaSeries::isKeyframe(int step) const
+{
+	return step % keyframeInterval == 0;
+}
+
+void DeltaSeries::brickBox(int brick, glm::ivec3 &origin, glm::ivec3 &extent) const
+{
+	glm::ivec3 coordinates(brick % brickCount.x, (brick / brickCount.x) % brickCount.y, brick / (brickCount.x * brickCount.y));
+	origin = coordinates * brickSize;
+	extent = glm::min(glm::ivec3(brickSize), dim - origin);
+}
+
+bool DeltaSeries::readStep(int step, Volume &volume, std::vector<int> &changedBricks)
+{
+	const DeltaStepEntry &entry = index[step];
+	record.resize(entry.size);
+	if (!seek64(file, entry.offset) || fread(record.data(), 1, record.size(), file) != record.size())
+		return false;
+	bytesRead += entry.size;
+
+	changedBricks.clear();
+	if (isKeyframe(step))
+	{
+		volume.dim = dim;
+		volume.data.resize(volume.voxelCount());
+		for (int b = 0; b < int(entry.brickCount); b++)
+			changedBricks.push_back(b);
+		return rleDecompress(record.data(), record.size(), volume.data.data(), volume.data.size());
+	}
+	if (volume.dim != dim)
+		return false;
+
+	// Find the payloads first, the bricks are disjoint and expand in parallel
+	std::vector<size_t> payloads;
+	size_t position = 0;
+	for (uint32_t i = 0; i < entry.brickCount; i++)
+	{
+		BrickRecord brick;
+		if (position + sizeof(brick) > record.size())
+			return false;
+		memcpy(&brick, &record[position], sizeof(brick));
+		if (brick.brick >= uint32_t(brickCount.x * brickCount.y * brickCount.z) || position + sizeof(brick) + brick.size > record.size())
+			return false;
+		changedBricks.push_back(int(brick.brick));
+		payloads.push_back(position);
+		position += sizeof(brick) + brick.size;
+	}
+
+	std::atomic<bool> ok(true);
+	parallelFor(0, int(payloads.size()), [&](int first, int last) {
+		std::vector<unsigned char> delta;
+		for (int i = first; i < last; i++)
+		{
+			BrickRecord brick;
+			memcpy(&brick, &record[payloads[i]], sizeof(brick));
+			glm::ivec3 origin, extent;
+			brickBox(int(brick.brick), origin, extent);
+			delta.resize(size_t(extent.x) * extent.y * extent.z);
+			if (!rleDecompress(&record[payloads[i] + sizeof(brick)], brick.size, delta.data(), delta.size()))
+			{
+				ok = false;
+				continue;
+			}
+
+			const unsigned char *bits = delta.data();
+			for (int z = 0; z < extent.z; z++)
+				for (int y = 0; y < extent.y; y++)
+				{
+					unsigned char *row = &volume.data[(size_t(origin.z + z) * dim.y + origin.y + y) * dim.x + origin.x];
+					for (int x = 0; x < extent.x; x++)
+						row[x] ^= *bits++;
+				}
+		}
+	});
+	return ok;
+}
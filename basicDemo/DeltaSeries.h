@@ -0,0 +1,121 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <glm/glm.hpp>
+
+class Volume;
+
+// Delta encoded time series file (.bdts). Every keyframeInterval timesteps
+// the whole volume is stored run length encoded, the timesteps in between
+// only store the bricks that changed, as the run length encoded XOR with the
+// previous timestep. A header, the timestep records and an index at the end
+struct DeltaSeriesHeader
+{
+	// "BDTS"
+	char magic[4];
+	// Format version
+	uint32_t version;
+	// Voxels per axis of every timestep
+	int32_t dim[3];
+	// Voxels per brick side
+	int32_t brickSize;
+	// Number of timesteps
+	int32_t stepCount;
+	// Timesteps from one keyframe to the next, timestep 0 is always a keyframe
+	int32_t keyframeInterval;
+	// Position of the index in the file
+	uint64_t indexOffset;
+};
+
+// Index entry of a timestep
+struct DeltaStepEntry
+{
+	// Position and bytes of the record
+	uint64_t offset;
+	uint32_t size;
+	// Bricks stored in the record (every brick for a keyframe)
+	uint32_t brickCount;
+};
+
+/**
+* Converts a series of raw unsigned byte files into a delta encoded series,
+* only two timesteps are held in memory. The bricks are compared and encoded
+* in parallel
+* @param{const char*} printf pattern of the input files, formatted with the timestep
+* @param{int} number of timesteps
+* @param{glm::ivec3 &} voxels per axis of every timestep
+* @param{const char*} output path
+* @param{int} voxels per brick side
+* @param{int} timesteps from one keyframe to the next
+* @returns{bool} true if the file could be written
+*/
+bool convertToDeltaSeries(const char *pattern, int count, const glm::ivec3 &dim, const char *outputPath, int brickSize, int keyframeInterval);
+
+// Reads the timesteps of a delta encoded series
+class DeltaSeries
+{
+public:
+	/**
+	* Creates a closed series
+	*/
+	DeltaSeries();
+
+	/**
+	* Closes the file
+	*/
+	~DeltaSeries();
+
+	/**
+	* Opens a delta encoded series and reads its index
+	* @param{const char*} path of the file
+	* @returns{bool} true if the file is a valid series
+	*/
+	bool open(const char *path);
+
+	/**
+	* Closes the file
+	*/
+	void close();
+
+	/**
+	* Brings a volume to a timestep. A keyframe overwrites the whole volume,
+	* any other timestep needs the volume to hold the previous one
+	* @param{int} timestep
+	* @param{Volume &} volume to update
+	* @param{std::vector<int> &} bricks that changed (every brick for a keyframe)
+	* @returns{bool} true if the timestep could be read
+	*/
+	bool readStep(int step, Volume &volume, std::vector<int> &changedBricks);
+
+	/**
+	* Checks if a timestep is stored whole
+	* @param{int} timestep
+	* @returns{bool} true for keyframes
+	*/
+	bool isKeyframe(int step) const;
+
+	/**
+	* First voxel and voxels per axis of a brick, border bricks are smaller
+	* @param{int} brick index (x-fastest)
+	* @param{glm::ivec3 &} first voxel
+	* @param{glm::ivec3 &} voxels per axis
+	*/
+	void brickBox(int brick, glm::ivec3 &origin, glm::ivec3 &extent) const;
+
+	// Voxels per axis of every timestep
+	glm::ivec3 dim;
+	// Bricks per axis
+	glm::ivec3 brickCount;
+	int brickSize;
+	int stepCount;
+	int keyframeInterval;
+	// Bytes read from the file so far
+	uint64_t bytesRead;
+
+private:
+	FILE *file;
+	std::vector<DeltaStepEntry> index;
+	// Record of the timestep being read
+	std::vector<unsigned char> record;
+};
@@ -0,0 +1,148 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "DerivedCache.h"
+#include "Volume.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	// Header of every artifact file
+	struct ArtifactHeader
+	{
+		// "DCAC"
+		char magic[4];
+		uint32_t version;
+		uint64_t hash;
+		uint64_t size;
+	};
+
+	const uint64_t hashPrime = 0x9E3779B97F4A7C15ull;
+	const size_t hashChunk = size_t(1) << 20;
+
+	inline uint64_t mix(uint64_t h)
+	{
+		h ^= h >> 33;
+		h *= 0xFF51AFD7ED558CCDull;
+		h ^= h >> 33;
+		return h;
+	}
+
+	// Multiply-rotate over 8 byte words, the tail is added byte by byte
+	uint64_t hashBytes(const unsigned char *data, size_t size, uint64_t seed)
+	{
+		uint64_t h = seed ^ (size * hashPrime);
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8)
+		{
+			uint64_t word;
+			memcpy(&word, data + i, sizeof(word));
+			h = ((h ^ mix(word)) * hashPrime);
+			h = (h << 31) | (h >> 33);
+		}
+		for (; i < size; i++)
+			h = (h ^ data[i]) * hashPrime;
+		return mix(h);
+	}
+}
+
+DerivedCache::DerivedCache() : hash(0), hits(0), misses(0), enabled(false)
+{
+}
+
+void DerivedCache::open(const char *directory, const Volume &volume)
+{
+	close();
+	this->directory = directory;
+	enabled = createDirectory(directory);
+	if (!enabled)
+		std::cout << "cache: no se puede crear " << directory << ", datos derivados sin cache" << std::endl;
+
+	// Chunks are hashed in parallel and combined in order
+	size_t bytes = volume.data.size();
+	int chunks = int((bytes + hashChunk - 1) / hashChunk);
+	std::vector<uint64_t> chunkHashes(chunks);
+	parallelFor(0, chunks, [&](int first, int last) {
+		for (int c = first; c < last; c++)
+		{
+			size_t begin = size_t(c) * hashChunk;
+			chunkHashes[c] = hashBytes(&volume.data[begin], std::min(hashChunk, bytes - begin), uint64_t(c));
+		}
+	});
+
+	hash = hashBytes((const unsigned char *)&volume.dim, sizeof(volume.dim), 0);
+	for (uint64_t chunkHash : chunkHashes)
+		hash = mix((hash ^ chunkHash) * hashPrime);
+	hits = misses = 0;
+}
+
+std::string DerivedCache::path(const char *name, int version) const
+{
+	char file[128];
+	snprintf(file, sizeof(file), "/%016llx_%s_v%d.bin", (unsigned long long)hash, name, version);
+	return directory + file;
+}
+
+const unsigned char *DerivedCache::load(const char *name, int version, size_t &size)
+{
+	std::unique_ptr<MappedFile> file(new MappedFile());
+	bool hit = enabled && file->open(path(name, version).c_str()) && file->size >= sizeof(ArtifactHeader);
+	if (hit)
+	{
+		ArtifactHeader header;
+		memcpy(&header, file->data, sizeof(header));
+		hit = memcmp(header.magic, "DCAC", 4) == 0 && header.version == uint32_t(version) && header.hash == hash &&
+			header.size == file->size - sizeof(header);
+	}
+
+	std::cout << "cache: " << (hit ? "acierto " : "fallo ") << name << " v" << version << std::endl;
+	if (!hit)
+	{
+		misses++;
+		return NULL;
+	}
+	hits++;
+	size = file->size - sizeof(ArtifactHeader);
+	const unsigned char *data = file->data + sizeof(ArtifactHeader);
+	mapped.push_back(std::move(file));
+	return data;
+}
+
+bool DerivedCache::store(const char *name, int version, const std::vector<CachePart> &parts)
+{
+	if (!enabled)
+		return false;
+
+	ArtifactHeader header;
+	memcpy(header.magic, "DCAC", 4);
+	header.version = uint32_t(version);
+	header.hash = hash;
+	header.size = 0;
+	for (const CachePart &part : parts)
+		header.size += part.size;
+
+	std::string final = path(name, version);
+	std::string temporary = final + ".tmp";
+	FILE *file = fopen(temporary.c_str(), "wb");
+	if (!file)
+		return false;
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	for (const CachePart &part : parts)
+		ok = ok && fwrite(part.data, 1, part.size, file) == part.size;
+	ok = fclose(file) == 0 && ok;
+
+	// rename does not replace an existing file on Windows
+	remove(final.c_str());
+	ok = ok && rename(temporary.c_str(), final.c_str()) == 0;
+	if (!ok)
+		remove(temporary.c_str());
+	return ok;
+}
+
+void DerivedCache::close()
+{
+	mapped.clear();
+}
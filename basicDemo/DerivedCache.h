@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Storage.h"
+
+class Volume;
+
+// Part of an artifact to store, artifacts are written as the concatenation of their parts
+struct CachePart
+{
+	const void *data;
+	size_t size;
+};
+
+// Sidecar cache of data derived from a volume (macrocells, gradients, mip
+// chain...). Every artifact is a file of the cache directory named after a
+// hash of the volume content, the artifact and the version of the algorithm
+// that made it, so a changed volume or algorithm never hits a stale file.
+// Hits are memory mapped and stay mapped until close
+class DerivedCache
+{
+public:
+	/**
+	* Creates a cache without a volume
+	*/
+	DerivedCache();
+
+	/**
+	* Hashes a volume (in parallel), the following artifacts belong to it
+	* @param{const char*} cache directory, created if missing
+	* @param{Volume &} volume the artifacts are derived from
+	*/
+	void open(const char *directory, const Volume &volume);
+
+	/**
+	* Maps a stored artifact
+	* @param{const char*} artifact name, includes its parameters (e.g. "macrocells16")
+	* @param{int} version of the algorithm that makes the artifact
+	* @param{size_t &} bytes of the artifact
+	* @returns{const unsigned char *} artifact data, NULL on a miss. Valid until close
+	*/
+	const unsigned char *load(const char *name, int version, size_t &size);
+
+	/**
+	* Stores an artifact, written to a temporary file first so a crash never leaves half a file
+	* @param{const char*} artifact name
+	* @param{int} version of the algorithm that makes the artifact
+	* @param{std::vector<CachePart> &} parts of the artifact
+	* @returns{bool} true if the artifact could be written
+	*/
+	bool store(const char *name, int version, const std::vector<CachePart> &parts);
+
+	/**
+	* Unmaps every artifact loaded
+	*/
+	void close();
+
+	// Hash of the volume content and size
+	uint64_t hash;
+	// Lookups that found / did not find their artifact
+	int hits;
+	int misses;
+
+private:
+	/**
+	* Path of an artifact file
+	*/
+	std::string path(const char *name, int version) const;
+
+	std::string directory;
+	bool enabled;
+	std::vector<std::unique_ptr<MappedFile> > mapped;
+};
@@ -0,0 +1,101 @@
+#include "DistanceGrid.h"
+#include "Shader.h"
+#include <glad/glad.h>
+#include <iostream>
+
+namespace
+{
+	void createDistanceTexture(unsigned int &id, const glm::ivec3 &count)
+	{
+		if (!id)
+			glGenTextures(1, &id);
+		glBindTexture(GL_TEXTURE_3D, id);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexImage3D(GL_TEXTURE_3D, 0, GL_R8UI, count.x, count.y, count.z, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, NULL);
+	}
+}
+
+DistanceGrid::DistanceGrid() : count(0), textureID(0), scratchTextureID(0), fbo(0), dirty(true)
+{
+}
+
+void DistanceGrid::create(const glm::ivec3 &cellCount)
+{
+	count = cellCount;
+	dirty = true;
+	createDistanceTexture(textureID, count);
+	createDistanceTexture(scratchTextureID, count);
+	if (!fbo)
+		glGenFramebuffers(1, &fbo);
+}
+
+void DistanceGrid::markDirty()
+{
+	dirty = true;
+}
+
+bool DistanceGrid::update(unsigned int occupancyTexture, Shader *shader, unsigned int quadVAO)
+{
+	if (!textureID || !dirty)
+		return false;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textureID, 0, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "ERROR::DISTANCE The distance texture is not renderable" << std::endl;
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		return false;
+	}
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glViewport(0, 0, count.x, count.y);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_CULL_FACE);
+
+	shader->use();
+	shader->setInt("occupancy", 0);
+	shader->setInt("source", 1);
+	shader->setIVec3("cellCount", count);
+	shader->setInt("maxDistance", maxDistance);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_3D, occupancyTexture);
+	glBindVertexArray(quadVAO);
+
+	// x: occupancy -> distance, y: distance -> scratch, z: scratch -> distance
+	unsigned int sources[3] = { 0, textureID, scratchTextureID };
+	unsigned int targets[3] = { textureID, scratchTextureID, textureID };
+	for (int axis = 0; axis < 3; axis++)
+	{
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_3D, sources[axis]);
+		shader->setInt("axis", axis);
+		for (int z = 0; z < count.z; z++)
+		{
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, targets[axis], 0, z);
+			shader->setInt("slice", z);
+			glDrawArrays(GL_TRIANGLES, 0, 6);
+		}
+	}
+	glActiveTexture(GL_TEXTURE0);
+
+	glBindVertexArray(0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glEnable(GL_DEPTH_TEST);
+	dirty = false;
+	return true;
+}
+
+void DistanceGrid::release()
+{
+	glDeleteTextures(1, &textureID);
+	glDeleteTextures(1, &scratchTextureID);
+	glDeleteFramebuffers(1, &fbo);
+	textureID = scratchTextureID = fbo = 0;
+}
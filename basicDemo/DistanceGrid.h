@@ -0,0 +1,58 @@
+#pragma once
+#include <glm/glm.hpp>
+
+class Shader;
+
+// Chebyshev distance, in macrocells, of every macrocell to the nearest
+// occupied one (0 = occupied). A ray in an empty cell can jump to the exit
+// of the whole cube of cells within that distance in a single step. It is
+// computed on the GPU from the occupancy bitfield with one pass per axis:
+// the L-infinity transform is separable as d(x) = min over x' of
+// max(|x - x'|, f(x')), f being the result of the previous axis
+class DistanceGrid
+{
+public:
+	/**
+	* Creates an empty grid
+	*/
+	DistanceGrid();
+
+	/**
+	* Allocates the distance textures (R8UI 3D)
+	* @param{glm::ivec3 &} macrocells per axis
+	*/
+	void create(const glm::ivec3 &cellCount);
+
+	/**
+	* The occupancy changed, the next update computes the distances again
+	*/
+	void markDirty();
+
+	/**
+	* Computes the distances if they are stale
+	* @param{unsigned int} GPU index of the occupancy bitfield texture
+	* @param{Shader *} distance shader
+	* @param{unsigned int} vertex array of a full screen quad (6 vertices)
+	* @returns{bool} true if the distances were computed
+	*/
+	bool update(unsigned int occupancyTexture, Shader *shader, unsigned int quadVAO);
+
+	/**
+	* Deletes the GPU objects
+	*/
+	void release();
+
+	// Largest distance stored, farther cells are clamped to it
+	static const int maxDistance = 255;
+
+	// Cells per axis
+	glm::ivec3 count;
+	// Index (GPU) of the distance texture
+	unsigned int textureID;
+
+private:
+	// The y pass writes here, the z pass reads it back into textureID
+	unsigned int scratchTextureID;
+	unsigned int fbo;
+	bool dirty;
+};
@@ -0,0 +1,82 @@
+#include "GpuTimer.h"
+#include <glad/glad.h>
+
+GpuTimer::GpuTimer() : next(0)
+{
+	for (int i = 0; i < queryCount; i++)
+	{
+		queries[i] = 0;
+		queryTags[i] = 0;
+		queryPending[i] = false;
+	}
+	reset();
+}
+
+void GpuTimer::begin(int tag)
+{
+	if (!queries[0])
+		glGenQueries(queryCount, queries);
+
+	// The ring wrapped onto a query the GPU has not finished, wait for it
+	if (queryPending[next])
+	{
+		GLuint64 elapsed;
+		glGetQueryObjectui64v(queries[next], GL_QUERY_RESULT, &elapsed);
+		total[queryTags[next]] += double(elapsed) * 1e-6;
+		samples[queryTags[next]]++;
+		queryPending[next] = false;
+	}
+	queryTags[next] = tag;
+	glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+}
+
+void GpuTimer::end()
+{
+	glEndQuery(GL_TIME_ELAPSED);
+	queryPending[next] = true;
+	next = (next + 1) % queryCount;
+}
+
+void GpuTimer::poll(bool wait)
+{
+	for (int i = 0; i < queryCount; i++)
+	{
+		if (!queryPending[i])
+			continue;
+		GLint available = GL_TRUE;
+		if (!wait)
+			glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			continue;
+		GLuint64 elapsed;
+		glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &elapsed);
+		total[queryTags[i]] += double(elapsed) * 1e-6;
+		samples[queryTags[i]]++;
+		queryPending[i] = false;
+	}
+}
+
+void GpuTimer::reset()
+{
+	for (int tag = 0; tag < tagCount; tag++)
+	{
+		total[tag] = 0.0;
+		samples[tag] = 0;
+	}
+}
+
+double GpuTimer::average(int tag) const
+{
+	return samples[tag] ? total[tag] / samples[tag] : 0.0;
+}
+
+void GpuTimer::release()
+{
+	if (queries[0])
+		glDeleteQueries(queryCount, queries);
+	for (int i = 0; i < queryCount; i++)
+	{
+		queries[i] = 0;
+		queryPending[i] = false;
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+// Times GPU work with GL_TIME_ELAPSED queries. Results are read a few
+// frames later, once available, so timing never stalls the pipeline. Every
+// measurement has a tag and the averages are kept per tag
+class GpuTimer
+{
+public:
+	/**
+	* Creates a timer without queries, they are created on first use
+	*/
+	GpuTimer();
+
+	/**
+	* Starts timing the following commands
+	* @param{int} tag of the measurement [0, tagCount)
+	*/
+	void begin(int tag);
+
+	/**
+	* Stops timing
+	*/
+	void end();
+
+	/**
+	* Collects the finished measurements
+	* @param{bool} waits for the ones still running
+	*/
+	void poll(bool wait);
+
+	/**
+	* Forgets every measurement collected
+	*/
+	void reset();
+
+	/**
+	* Average time of the collected measurements of a tag
+	* @param{int} tag
+	* @returns{double} milliseconds, 0 if there are none
+	*/
+	double average(int tag) const;
+
+	/**
+	* Deletes the queries
+	*/
+	void release();
+
+	// Queries in flight
+	static const int queryCount = 8;
+	static const int tagCount = 4;
+
+	// Measurements collected per tag
+	int samples[tagCount];
+
+private:
+	unsigned int queries[queryCount];
+	int queryTags[queryCount];
+	bool queryPending[queryCount];
+	// Query used by the next begin
+	int next;
+	double total[tagCount];
+};
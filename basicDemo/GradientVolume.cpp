@@ -0,0 +1,253 @@
+#include "GradientVolume.h"
+#include "Volume.h"
+#include "Shader.h"
+#include "Parallel.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GRADIENT_SSE2
+#include <emmintrin.h>
+#endif
+
+// Central differences over unsigned bytes are divided by 2 * 255, each axis is at most 0.5
+const float GradientVolume::maxMagnitude = 0.8660254f;
+
+namespace
+{
+	const float differenceScale = 1.0f / (2.0f * 255.0f);
+
+	inline signed char toSnorm8(float v)
+	{
+		return (signed char)std::lround(std::min(std::max(v, -1.0f), 1.0f) * 127.0f);
+	}
+
+	inline unsigned char toCompandedMagnitude(float magnitude)
+	{
+		float normalized = std::min(magnitude / GradientVolume::maxMagnitude, 1.0f);
+		return (unsigned char)std::lround(std::sqrt(normalized) * 255.0f);
+	}
+
+	// Octahedral encoding of a gradient, zero gradients are stored as (0, 0)
+	void encodeScalar(float gx, float gy, float gz, signed char *normal, unsigned char *magnitude)
+	{
+		float l1 = std::fabs(gx) + std::fabs(gy) + std::fabs(gz);
+		float ex = 0.0f, ey = 0.0f;
+		if (l1 > 0.0f)
+		{
+			ex = gx / l1;
+			ey = gy / l1;
+			if (gz < 0.0f)
+			{
+				float fx = (1.0f - std::fabs(ey)) * (ex >= 0.0f ? 1.0f : -1.0f);
+				float fy = (1.0f - std::fabs(ex)) * (ey >= 0.0f ? 1.0f : -1.0f);
+				ex = fx;
+				ey = fy;
+			}
+		}
+		normal[0] = toSnorm8(ex);
+		normal[1] = toSnorm8(ey);
+		*magnitude = toCompandedMagnitude(std::sqrt(gx * gx + gy * gy + gz * gz));
+	}
+
+#ifdef GRADIENT_SSE2
+	inline __m128 loadBytes4(const unsigned char *p)
+	{
+		int word;
+		memcpy(&word, p, sizeof(word));
+		__m128i zero = _mm_setzero_si128();
+		__m128i v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(word), zero);
+		return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+	}
+
+	// Encodes 4 gradients at once, same math as encodeScalar
+	void encode4(__m128 gx, __m128 gy, __m128 gz, signed char *normal, unsigned char *magnitude)
+	{
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 zero = _mm_setzero_ps();
+
+		__m128 ax = _mm_andnot_ps(signMask, gx);
+		__m128 ay = _mm_andnot_ps(signMask, gy);
+		__m128 az = _mm_andnot_ps(signMask, gz);
+		__m128 l1 = _mm_add_ps(_mm_add_ps(ax, ay), az);
+		__m128 inv = _mm_and_ps(_mm_cmpgt_ps(l1, zero), _mm_div_ps(one, _mm_max_ps(l1, _mm_set1_ps(1e-20f))));
+
+		__m128 ox = _mm_mul_ps(gx, inv);
+		__m128 oy = _mm_mul_ps(gy, inv);
+		// Lower hemisphere folding, sign(0) counts as positive
+		__m128 sx = _mm_or_ps(_mm_and_ps(ox, signMask), one);
+		__m128 sy = _mm_or_ps(_mm_and_ps(oy, signMask), one);
+		__m128 fx = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, oy)), sx);
+		__m128 fy = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, ox)), sy);
+		__m128 lower = _mm_cmplt_ps(gz, zero);
+		__m128 ex = _mm_or_ps(_mm_and_ps(lower, fx), _mm_andnot_ps(lower, ox));
+		__m128 ey = _mm_or_ps(_mm_and_ps(lower, fy), _mm_andnot_ps(lower, oy));
+
+		__m128 scale = _mm_set1_ps(127.0f);
+		__m128i ix = _mm_cvtps_epi32(_mm_mul_ps(ex, scale));
+		__m128i iy = _mm_cvtps_epi32(_mm_mul_ps(ey, scale));
+
+		__m128 mag = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy)), _mm_mul_ps(gz, gz)));
+		mag = _mm_min_ps(_mm_mul_ps(mag, _mm_set1_ps(1.0f / GradientVolume::maxMagnitude)), one);
+		__m128i im = _mm_cvtps_epi32(_mm_mul_ps(_mm_sqrt_ps(mag), _mm_set1_ps(255.0f)));
+
+		int x[4], y[4], m[4];
+		_mm_storeu_si128((__m128i *)x, ix);
+		_mm_storeu_si128((__m128i *)y, iy);
+		_mm_storeu_si128((__m128i *)m, im);
+		for (int i = 0; i < 4; i++)
+		{
+			normal[i * 2] = (signed char)x[i];
+			normal[i * 2 + 1] = (signed char)y[i];
+			magnitude[i] = (unsigned char)m[i];
+		}
+	}
+#endif
+}
+
+GradientVolume::GradientVolume() : dim(0), normalTextureID(0), magnitudeTextureID(0)
+{
+}
+
+void GradientVolume::build(const Volume &volume)
+{
+	dim = volume.dim;
+	normals.assign(volume.voxelCount() * 2, 0);
+	magnitudes.assign(volume.voxelCount(), 0);
+
+	parallelFor(0, dim.z, [&](int firstSlice, int lastSlice) {
+		for (int z = firstSlice; z < lastSlice; z++)
+			for (int y = 0; y < dim.y; y++)
+			{
+				size_t row = (size_t(z) * dim.y + y) * dim.x;
+				// Neighbour rows, clamped to the border
+				const unsigned char *down = &volume.data[(size_t(z) * dim.y + std::max(y - 1, 0)) * dim.x];
+				const unsigned char *up = &volume.data[(size_t(z) * dim.y + std::min(y + 1, dim.y - 1)) * dim.x];
+				const unsigned char *back = &volume.data[(size_t(std::max(z - 1, 0)) * dim.y + y) * dim.x];
+				const unsigned char *front = &volume.data[(size_t(std::min(z + 1, dim.z - 1)) * dim.y + y) * dim.x];
+				const unsigned char *center = &volume.data[row];
+
+				int x = 0;
+#ifdef GRADIENT_SSE2
+				// The first and last voxels of the row need clamping, done in the scalar loop
+				const __m128 scale = _mm_set1_ps(differenceScale);
+				for (x = 1; x + 4 < dim.x; x += 4)
+				{
+					__m128 gx = _mm_mul_ps(_mm_sub_ps(loadBytes4(center + x + 1), loadBytes4(center + x - 1)), scale);
+					__m128 gy = _mm_mul_ps(_mm_sub_ps(loadBytes4(up + x), loadBytes4(down + x)), scale);
+					__m128 gz = _mm_mul_ps(_mm_sub_ps(loadBytes4(front + x), loadBytes4(back + x)), scale);
+					encode4(gx, gy, gz, &normals[(row + x) * 2], &magnitudes[row + x]);
+				}
+				encodeScalar(
+					(float(center[std::min(1, dim.x - 1)]) - float(center[0])) * differenceScale,
+					(float(up[0]) - float(down[0])) * differenceScale,
+					(float(front[0]) - float(back[0])) * differenceScale,
+					&normals[row * 2], &magnitudes[row]);
+#endif
+				for (; x < dim.x; x++)
+				{
+					float gx = (float(center[std::min(x + 1, dim.x - 1)]) - float(center[std::max(x - 1, 0)])) * differenceScale;
+					float gy = (float(up[x]) - float(down[x])) * differenceScale;
+					float gz = (float(front[x]) - float(back[x])) * differenceScale;
+					encodeScalar(gx, gy, gz, &normals[(row + x) * 2], &magnitudes[row + x]);
+				}
+			}
+	});
+}
+
+void GradientVolume::createTextures(const void *normalData, const void *magnitudeData)
+{
+	if (!normalTextureID)
+		glGenTextures(1, &normalTextureID);
+	if (!magnitudeTextureID)
+		glGenTextures(1, &magnitudeTextureID);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	unsigned int textures[2] = { normalTextureID, magnitudeTextureID };
+	for (unsigned int texture : textures)
+	{
+		glBindTexture(GL_TEXTURE_3D, texture);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	}
+
+	glBindTexture(GL_TEXTURE_3D, normalTextureID);
+	glTexImage3D(GL_TEXTURE_3D, 0, GL_RG8_SNORM, dim.x, dim.y, dim.z, 0, GL_RG, GL_BYTE, normalData);
+	glBindTexture(GL_TEXTURE_3D, magnitudeTextureID);
+	glTexImage3D(GL_TEXTURE_3D, 0, GL_R8, dim.x, dim.y, dim.z, 0, GL_RED, GL_UNSIGNED_BYTE, magnitudeData);
+}
+
+void GradientVolume::upload()
+{
+	createTextures(normals.data(), magnitudes.data());
+}
+
+void GradientVolume::upload(const glm::ivec3 &dim, const void *normalData, const void *magnitudeData)
+{
+	this->dim = dim;
+	normals.clear();
+	magnitudes.clear();
+	createTextures(normalData, magnitudeData);
+}
+
+bool GradientVolume::buildOnGPU(const Volume &volume, unsigned int volumeTexture, Shader *shader, unsigned int quadVAO)
+{
+	dim = volume.dim;
+	normals.clear();
+	magnitudes.clear();
+	createTextures(NULL, NULL);
+
+	unsigned int fbo;
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	unsigned int drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, drawBuffers);
+
+	// Snorm formats are not required to be renderable in OpenGL 3.3
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, normalTextureID, 0, 0);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, magnitudeTextureID, 0, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "ERROR::GRADIENT The gradient textures are not renderable, use the CPU path" << std::endl;
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(1, &fbo);
+		return false;
+	}
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glViewport(0, 0, dim.x, dim.y);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_CULL_FACE);
+
+	shader->use();
+	shader->setInt("volume", 0);
+	shader->setIVec3("volumeSize", dim);
+	shader->setFloat("maxMagnitude", maxMagnitude);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_3D, volumeTexture);
+	glBindVertexArray(quadVAO);
+
+	for (int z = 0; z < dim.z; z++)
+	{
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, normalTextureID, 0, z);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, magnitudeTextureID, 0, z);
+		shader->setInt("slice", z);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+	}
+
+	glBindVertexArray(0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &fbo);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glEnable(GL_DEPTH_TEST);
+	return true;
+}
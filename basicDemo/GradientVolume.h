@@ -0,0 +1,74 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+class Volume;
+class Shader;
+
+// Precomputed central difference gradients of a volume. The direction is
+// stored octahedral encoded in a RG8_SNORM texture and the magnitude in a
+// separate R8 texture, 3 bytes per voxel instead of 12 for RGB float
+class GradientVolume
+{
+public:
+	/**
+	* Creates an empty gradient volume
+	*/
+	GradientVolume();
+
+	/**
+	* Computes the gradients on the CPU, slices are split among all the
+	* hardware threads and rows are processed 4 voxels at a time with SSE
+	* @param{Volume &} source volume
+	*/
+	void build(const Volume &volume);
+
+	/**
+	* Loads the CPU gradients into the GPU
+	*/
+	void upload();
+
+	/**
+	* Loads gradients computed elsewhere (e.g. the derived data cache) into
+	* the GPU, the CPU copies stay empty
+	* @param{glm::ivec3 &} voxels per axis
+	* @param{const void *} octahedral directions, 2 signed bytes per voxel
+	* @param{const void *} companded magnitudes, 1 byte per voxel
+	*/
+	void upload(const glm::ivec3 &dim, const void *normalData, const void *magnitudeData);
+
+	/**
+	* Computes the gradients directly on the GPU, rendering every slice of the
+	* gradient textures with a fragment shader
+	* @param{Volume &} source volume (only its size is used)
+	* @param{unsigned int} GPU index of the volume 3D texture
+	* @param{Shader *} gradient shader
+	* @param{unsigned int} vertex array of a full screen quad (6 vertices)
+	* @returns{bool} false if the driver cannot render into the gradient textures
+	*/
+	bool buildOnGPU(const Volume &volume, unsigned int volumeTexture, Shader *shader, unsigned int quadVAO);
+
+	// Voxels per axis
+	glm::ivec3 dim;
+	// Octahedral encoded gradient directions, 2 per voxel
+	std::vector<signed char> normals;
+	// Gradient magnitudes, sqrt companded (see maxMagnitude)
+	std::vector<unsigned char> magnitudes;
+	// Index (GPU) of the direction texture
+	unsigned int normalTextureID;
+	// Index (GPU) of the magnitude texture
+	unsigned int magnitudeTextureID;
+
+	// Largest magnitude a gradient of normalized densities can have, a stored
+	// value m decodes to (m / 255)^2 * maxMagnitude
+	static const float maxMagnitude;
+
+	// Version of the encoding, part of the derived data cache key
+	static const int version = 1;
+
+private:
+	/**
+	* Creates both textures with the given data (NULL to leave them undefined)
+	*/
+	void createTextures(const void *normalData, const void *magnitudeData);
+};
@@ -0,0 +1,118 @@
+#include "MacrocellGrid.h"
+#include "Volume.h"
+#include "BrickFile.h"
+#include <glad/glad.h>
+#include <algorithm>
+
+MacrocellGrid::MacrocellGrid() : count(0), cellSize(0), textureID(0)
+{
+}
+
+void MacrocellGrid::build(const Volume &volume, int cellSize)
+{
+	this->cellSize = cellSize;
+	count = (volume.dim + cellSize - 1) / cellSize;
+	minMax.assign(size_t(count.x) * count.y * count.z * 2, 0);
+
+	for (int cz = 0; cz < count.z; cz++)
+		for (int cy = 0; cy < count.y; cy++)
+			for (int cx = 0; cx < count.x; cx++)
+				updateCell(volume, glm::ivec3(cx, cy, cz));
+}
+
+void MacrocellGrid::updateCell(const Volume &volume, const glm::ivec3 &cell)
+{
+	glm::ivec3 first = glm::max(cell * cellSize - 1, glm::ivec3(0));
+	glm::ivec3 last = glm::min((cell + 1) * cellSize, volume.dim - 1);
+
+	unsigned char lo = 255, hi = 0;
+	for (int z = first.z; z <= last.z; z++)
+		for (int y = first.y; y <= last.y; y++)
+		{
+			const unsigned char *row = &volume.data[(size_t(z) * volume.dim.y + y) * volume.dim.x];
+			for (int x = first.x; x <= last.x; x++)
+			{
+				lo = std::min(lo, row[x]);
+				hi = std::max(hi, row[x]);
+			}
+		}
+
+	size_t index = (size_t(cell.z) * count.y + cell.y) * count.x + cell.x;
+	minMax[index * 2] = lo;
+	minMax[index * 2 + 1] = hi;
+}
+
+void MacrocellGrid::build(const BrickFileSource &bricks)
+{
+	// The brick ranges include the apron, same as the cells built from voxels
+	cellSize = bricks.brickSize();
+	count = bricks.brickCount(0);
+	minMax.assign(size_t(count.x) * count.y * count.z * 2, 0);
+
+	for (int cz = 0; cz < count.z; cz++)
+		for (int cy = 0; cy < count.y; cy++)
+			for (int cx = 0; cx < count.x; cx++)
+			{
+				const BrickFileEntry &entry = bricks.entry(0, glm::ivec3(cx, cy, cz));
+				size_t cell = (size_t(cz) * count.y + cy) * count.x + cx;
+				minMax[cell * 2] = entry.minValue;
+				minMax[cell * 2 + 1] = entry.maxValue;
+			}
+}
+
+void MacrocellGrid::upload()
+{
+	if (!textureID)
+		glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_3D, textureID);
+
+	// Cells are looked up as a whole, they must not be interpolated
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage3D(GL_TEXTURE_3D, 0, GL_RG8, count.x, count.y, count.z, 0, GL_RG, GL_UNSIGNED_BYTE, minMax.data());
+}
+
+void MacrocellGrid::uploadCells(const glm::ivec3 &first, const glm::ivec3 &last)
+{
+	glBindTexture(GL_TEXTURE_3D, textureID);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	// Box of the whole grid array
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, count.x);
+	glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, count.y);
+	glPixelStorei(GL_UNPACK_SKIP_PIXELS, first.x);
+	glPixelStorei(GL_UNPACK_SKIP_ROWS, first.y);
+	glPixelStorei(GL_UNPACK_SKIP_IMAGES, first.z);
+	glm::ivec3 size = last - first + 1;
+	glTexSubImage3D(GL_TEXTURE_3D, 0, first.x, first.y, first.z, size.x, size.y, size.z, GL_RG, GL_UNSIGNED_BYTE, minMax.data());
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, 0);
+	glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+	glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+	glPixelStorei(GL_UNPACK_SKIP_IMAGES, 0);
+}
+
+std::vector<unsigned char> MacrocellGrid::occupiedCells(const std::vector<unsigned char> &visible, const glm::vec3 &cropFirst, const glm::vec3 &cropLast) const
+{
+	// Visible densities below every entry, a cell range [lo, hi] is occupied if the count grows across it
+	std::vector<int> prefix(visible.size() + 1, 0);
+	for (size_t i = 0; i < visible.size(); i++)
+		prefix[i + 1] = prefix[i] + (visible[i] ? 1 : 0);
+
+	// Cells that overlap the crop box, the rest are left empty
+	glm::ivec3 first = glm::max(glm::ivec3(glm::floor(cropFirst / float(cellSize))), glm::ivec3(0));
+	glm::ivec3 last = glm::min(glm::ivec3(glm::ceil(cropLast / float(cellSize))) - 1, count - 1);
+	std::vector<unsigned char> occupied(minMax.size() / 2, 0);
+	for (int z = first.z; z <= last.z; z++)
+		for (int y = first.y; y <= last.y; y++)
+			for (int x = first.x; x <= last.x; x++)
+			{
+				size_t i = (size_t(z) * count.y + y) * count.x + x;
+				occupied[i] = prefix[minMax[i * 2 + 1] + 1] > prefix[minMax[i * 2]];
+			}
+	return occupied;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+class Volume;
+class BrickFileSource;
+
+// Coarse grid that stores the minimum and maximum voxel value of every
+// cellSize^3 block of the volume, the raycaster uses it to skip empty space
+class MacrocellGrid
+{
+public:
+	/**
+	* Creates an empty grid
+	*/
+	MacrocellGrid();
+
+	/**
+	* Computes the min/max of every cell, each cell also covers one voxel
+	* of its neighbours so trilinear samples at the cell border are bounded
+	* @param{Volume &} source volume
+	* @param{int} voxels per cell side
+	*/
+	void build(const Volume &volume, int cellSize);
+
+	/**
+	* Recomputes the min/max of one cell after its voxels changed
+	* @param{Volume &} source volume
+	* @param{glm::ivec3 &} cell coordinates
+	*/
+	void updateCell(const Volume &volume, const glm::ivec3 &cell);
+
+	/**
+	* Takes the min/max of every level 0 brick from a brick file index, one
+	* cell per brick, so out of core volumes skip empty space without their
+	* voxels being read
+	* @param{BrickFileSource &} opened brick file
+	*/
+	void build(const BrickFileSource &bricks);
+
+	/**
+	* Loads the grid into the GPU as a RG8 3D texture (r = min, g = max)
+	*/
+	void upload();
+
+	/**
+	* Loads a box of cells into the existing texture
+	* @param{glm::ivec3 &} first cell of the box
+	* @param{glm::ivec3 &} last cell of the box (included)
+	*/
+	void uploadCells(const glm::ivec3 &first, const glm::ivec3 &last);
+
+	/**
+	* Marks the cells inside a crop box whose value range holds a density that counts
+	* @param{std::vector<unsigned char> &} densities (256 entries) that can change a ray
+	* @param{glm::vec3 &} lower corner of the crop box (voxels)
+	* @param{glm::vec3 &} upper corner of the crop box (voxels)
+	* @returns{std::vector<unsigned char>} one entry per cell (x fastest), non zero if occupied
+	*/
+	std::vector<unsigned char> occupiedCells(const std::vector<unsigned char> &visible, const glm::vec3 &cropFirst, const glm::vec3 &cropLast) const;
+
+	// Cells per axis
+	glm::ivec3 count;
+	// Voxels per cell side
+	int cellSize;
+	// Interleaved min/max of every cell
+	std::vector<unsigned char> minMax;
+	// Index (GPU) of the grid texture
+	unsigned int textureID;
+
+	// Version of the build algorithm, part of the derived data cache key
+	static const int version = 1;
+};
@@ -0,0 +1,156 @@
+#include "OcclusionPyramid.h"
+#include "Shader.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <iostream>
+
+OcclusionPyramid::OcclusionPyramid() : size(0), valid(false), textureID(0), fbo(0), pbo(0), pending(false), reducedSize(0)
+{
+}
+
+void OcclusionPyramid::resize(int width, int height)
+{
+	size = glm::ivec2(width, height);
+	reducedSize = glm::max((size + blockSize - 1) / blockSize, glm::ivec2(1));
+	valid = false;
+	pending = false;
+
+	if (!textureID)
+	{
+		glGenTextures(1, &textureID);
+		glGenFramebuffers(1, &fbo);
+		glGenBuffers(1, &pbo);
+	}
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, reducedSize.x, reducedSize.y, 0, GL_RED, GL_FLOAT, NULL);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureID, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::OCCLUSION The reduced depth target is not renderable" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+	glBufferData(GL_PIXEL_PACK_BUFFER, size_t(reducedSize.x) * reducedSize.y * sizeof(float), NULL, GL_STREAM_READ);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	// Every level halves the previous one down to a single texel
+	levelSize.clear();
+	glm::ivec2 levelDim = reducedSize;
+	levelSize.push_back(levelDim);
+	while (levelDim.x > 1 || levelDim.y > 1)
+	{
+		levelDim = (levelDim + 1) / 2;
+		levelSize.push_back(levelDim);
+	}
+	levels.resize(levelSize.size());
+	for (size_t i = 0; i < levels.size(); i++)
+		levels[i].assign(size_t(levelSize[i].x) * levelSize[i].y, 1.0f);
+}
+
+void OcclusionPyramid::update(unsigned int depthTexture, Shader *shader, unsigned int quadVAO)
+{
+	if (!textureID)
+		return;
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	GLint drawFramebuffer;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glViewport(0, 0, reducedSize.x, reducedSize.y);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_CULL_FACE);
+
+	shader->use();
+	shader->setInt("depth", 0);
+	shader->setIVec2("depthSize", size);
+	shader->setInt("blockSize", blockSize);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, depthTexture);
+	glBindVertexArray(quadVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+	glBindVertexArray(0);
+
+	// Copied into the pixel buffer without waiting, it is mapped next frame
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glReadPixels(0, 0, reducedSize.x, reducedSize.y, GL_RED, GL_FLOAT, (void *)0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	pending = true;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, drawFramebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_CULL_FACE);
+}
+
+bool OcclusionPyramid::readback()
+{
+	if (!pending)
+		return valid;
+	pending = false;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+	const float *depths = (const float *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, levels[0].size() * sizeof(float), GL_MAP_READ_BIT);
+	if (depths)
+	{
+		std::copy(depths, depths + levels[0].size(), levels[0].begin());
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	if (!depths)
+		return valid = false;
+
+	// Each texel keeps the farthest occluder of the 2x2 texels below it, the odd edges are clamped
+	for (size_t level = 1; level < levels.size(); level++)
+	{
+		const std::vector<float> &below = levels[level - 1];
+		glm::ivec2 belowSize = levelSize[level - 1];
+		glm::ivec2 levelDim = levelSize[level];
+		for (int y = 0; y < levelDim.y; y++)
+			for (int x = 0; x < levelDim.x; x++)
+			{
+				int x0 = 2 * x, x1 = std::min(2 * x + 1, belowSize.x - 1);
+				int y0 = 2 * y, y1 = std::min(2 * y + 1, belowSize.y - 1);
+				levels[level][size_t(y) * levelDim.x + x] = std::max(
+					std::max(below[size_t(y0) * belowSize.x + x0], below[size_t(y0) * belowSize.x + x1]),
+					std::max(below[size_t(y1) * belowSize.x + x0], below[size_t(y1) * belowSize.x + x1]));
+			}
+	}
+	return valid = true;
+}
+
+bool OcclusionPyramid::occluded(const glm::vec2 &first, const glm::vec2 &last, float depth) const
+{
+	if (!valid)
+		return false;
+
+	// Texels of the GPU reduction under the rectangle
+	glm::ivec2 texelFirst = glm::clamp(glm::ivec2(glm::floor(first)) / blockSize, glm::ivec2(0), reducedSize - 1);
+	glm::ivec2 texelLast = glm::clamp(glm::ivec2(glm::floor(last)) / blockSize, glm::ivec2(0), reducedSize - 1);
+
+	// Coarsest level that still covers the rectangle with at most 4x4 texels (5x5 when it straddles them)
+	glm::ivec2 span = texelLast - texelFirst;
+	size_t level = 0;
+	while (level + 1 < levels.size() && ((span.x >> level) > 3 || (span.y >> level) > 3))
+		level++;
+
+	glm::ivec2 levelDim = levelSize[level];
+	for (int y = texelFirst.y >> level; y <= (texelLast.y >> level); y++)
+		for (int x = texelFirst.x >> level; x <= (texelLast.x >> level); x++)
+			if (levels[level][size_t(y) * levelDim.x + x] >= depth)
+				return false;
+	return true;
+}
+
+void OcclusionPyramid::release()
+{
+	glDeleteTextures(1, &textureID);
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteBuffers(1, &pbo);
+	textureID = fbo = pbo = 0;
+	valid = pending = false;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+class Shader;
+
+// Max depth pyramid of the occluders of the previous frame. The brick
+// fragments that turn opaque on their own write their depth, a fragment
+// pass reduces the depth buffer by blockSize^2 on the GPU and the small
+// result is read back one frame later through a pixel buffer, where the
+// rest of the pyramid is built. A brick whose nearest depth lies behind
+// the farthest occluder over its screen rectangle cannot be seen
+class OcclusionPyramid
+{
+public:
+	/**
+	* Creates an empty pyramid
+	*/
+	OcclusionPyramid();
+
+	/**
+	* Allocates the reduced depth target for a window size, the pyramid is invalid until the next readback
+	* @param{int} window width
+	* @param{int} window height
+	*/
+	void resize(int width, int height);
+
+	/**
+	* Reduces the depth buffer of the frame and starts its readback
+	* @param{unsigned int} GPU index of the depth texture (window size)
+	* @param{Shader *} reduction shader
+	* @param{unsigned int} vertex array of a full screen quad (6 vertices)
+	*/
+	void update(unsigned int depthTexture, Shader *shader, unsigned int quadVAO);
+
+	/**
+	* Builds the pyramid from the readback of the last update, if any
+	* @returns{bool} true if the pyramid can be used
+	*/
+	bool readback();
+
+	/**
+	* Tests a screen rectangle against the occluders
+	* @param{glm::vec2 &} lower corner of the rectangle (window pixels, origin at the bottom left)
+	* @param{glm::vec2 &} upper corner of the rectangle
+	* @param{float} nearest depth of what the rectangle bounds
+	* @returns{bool} true if it is behind the occluders over the whole rectangle
+	*/
+	bool occluded(const glm::vec2 &first, const glm::vec2 &last, float depth) const;
+
+	/**
+	* Deletes the GPU objects
+	*/
+	void release();
+
+	// Window pixels per side of the texels of the GPU reduction
+	static const int blockSize = 8;
+
+	// Window size
+	glm::ivec2 size;
+	// The pyramid holds a previous frame of the current window size
+	bool valid;
+
+private:
+	unsigned int textureID, fbo, pbo;
+	// A readback was started and not read yet
+	bool pending;
+	// Size of the reduced target (level 0)
+	glm::ivec2 reducedSize;
+	// Max depth levels, level 0 is the GPU reduction
+	std::vector<std::vector<float> > levels;
+	std::vector<glm::ivec2> levelSize;
+};
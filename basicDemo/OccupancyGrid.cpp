@@ -0,0 +1,110 @@
+#include "OccupancyGrid.h"
+#include "TransferFunction.h"
+#include "Shader.h"
+#include <glad/glad.h>
+#include <iostream>
+
+OccupancyGrid::OccupancyGrid() : count(0), textureID(0), prefixTextureID(0), fbo(0), dirty(true)
+{
+}
+
+void OccupancyGrid::create(const glm::ivec3 &cellCount)
+{
+	count = cellCount;
+	dirty = true;
+
+	if (!textureID)
+		glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_3D, textureID);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexImage3D(GL_TEXTURE_3D, 0, GL_R8UI, (count.x + 7) / 8, count.y, count.z, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, NULL);
+
+	if (!prefixTextureID)
+		glGenTextures(1, &prefixTextureID);
+	glBindTexture(GL_TEXTURE_1D, prefixTextureID);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexImage1D(GL_TEXTURE_1D, 0, GL_R32F, TransferFunction::size + 1, 0, GL_RED, GL_FLOAT, NULL);
+	prefix.clear();
+
+	if (!fbo)
+		glGenFramebuffers(1, &fbo);
+}
+
+void OccupancyGrid::markDirty()
+{
+	dirty = true;
+}
+
+bool OccupancyGrid::update(const TransferFunction &transferFunction, unsigned int macrocellTexture, Shader *shader, unsigned int quadVAO)
+{
+	if (!textureID)
+		return false;
+
+	// Visible densities below every entry: a cell range [lo, hi] is occupied if prefix[hi + 1] > prefix[lo]
+	std::vector<float> table(TransferFunction::size + 1, 0.0f);
+	for (int i = 0; i < TransferFunction::size; i++)
+		table[i + 1] = table[i] + (transferFunction.table[i].a > 0.0f ? 1.0f : 0.0f);
+	if (table != prefix)
+	{
+		prefix.swap(table);
+		glBindTexture(GL_TEXTURE_1D, prefixTextureID);
+		glTexSubImage1D(GL_TEXTURE_1D, 0, 0, GLsizei(prefix.size()), GL_RED, GL_FLOAT, prefix.data());
+		dirty = true;
+	}
+	if (!dirty)
+		return false;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textureID, 0, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "ERROR::OCCUPANCY The occupancy bitfield is not renderable" << std::endl;
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		return false;
+	}
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glViewport(0, 0, (count.x + 7) / 8, count.y);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_CULL_FACE);
+
+	shader->use();
+	shader->setInt("macrocells", 0);
+	shader->setInt("visiblePrefix", 1);
+	shader->setIVec3("cellCount", count);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_3D, macrocellTexture);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_1D, prefixTextureID);
+	glActiveTexture(GL_TEXTURE0);
+	glBindVertexArray(quadVAO);
+
+	for (int z = 0; z < count.z; z++)
+	{
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textureID, 0, z);
+		shader->setInt("slice", z);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+	}
+
+	glBindVertexArray(0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glEnable(GL_DEPTH_TEST);
+	dirty = false;
+	return true;
+}
+
+void OccupancyGrid::release()
+{
+	glDeleteTextures(1, &textureID);
+	glDeleteTextures(1, &prefixTextureID);
+	glDeleteFramebuffers(1, &fbo);
+	textureID = prefixTextureID = fbo = 0;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+class Shader;
+class TransferFunction;
+
+// One bit per macrocell, set if the cell holds a density with a non zero
+// opacity. It is derived from the min/max grid and the transfer function,
+// so an edit of either makes it stale: a fragment pass rewrites it on the
+// GPU from the min/max texture and a prefix table of the visible
+// densities, and the raycaster reads it the same frame with no readback
+class OccupancyGrid
+{
+public:
+	/**
+	* Creates an empty grid
+	*/
+	OccupancyGrid();
+
+	/**
+	* Allocates the bitfield of a macrocell grid as a R8UI 3D texture,
+	* 8 cells along x per texel (bit i = cell 8 * x + i)
+	* @param{glm::ivec3 &} macrocells per axis
+	*/
+	void create(const glm::ivec3 &cellCount);
+
+	/**
+	* The min/max grid changed, the next update rewrites the bitfield
+	*/
+	void markDirty();
+
+	/**
+	* Rewrites the bitfield if it is stale (new min/max or visible densities),
+	* one slice of cells per draw
+	* @param{TransferFunction &} current transfer function
+	* @param{unsigned int} GPU index of the min/max grid texture
+	* @param{Shader *} occupancy shader
+	* @param{unsigned int} vertex array of a full screen quad (6 vertices)
+	* @returns{bool} true if the bitfield was rewritten
+	*/
+	bool update(const TransferFunction &transferFunction, unsigned int macrocellTexture, Shader *shader, unsigned int quadVAO);
+
+	/**
+	* Deletes the GPU objects
+	*/
+	void release();
+
+	// Cells per axis
+	glm::ivec3 count;
+	// Index (GPU) of the bitfield texture
+	unsigned int textureID;
+	// Index (GPU) of the visible density prefix table (entry i = visible densities below i)
+	unsigned int prefixTextureID;
+
+private:
+	unsigned int fbo;
+	bool dirty;
+	// Prefix table of the last update
+	std::vector<float> prefix;
+};
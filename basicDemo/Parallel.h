@@ -0,0 +1,37 @@
+#pragma once
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+/**
+* Splits [begin, end) in contiguous chunks and runs them on all the hardware threads
+* @param{int} first index
+* @param{int} one past the last index
+* @param{Body} callable as body(int chunkBegin, int chunkEnd)
+*/
+template <typename Body>
+void parallelFor(int begin, int end, Body body)
+{
+	int count = end - begin;
+	if (count <= 0)
+		return;
+
+	int threadCount = std::max(1, std::min(int(std::thread::hardware_concurrency()), count));
+	if (threadCount == 1)
+	{
+		body(begin, end);
+		return;
+	}
+
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount - 1);
+	int chunk = (count + threadCount - 1) / threadCount;
+	for (int first = begin + chunk; first < end; first += chunk)
+		threads.emplace_back(body, first, std::min(first + chunk, end));
+
+	// The calling thread takes the first chunk
+	body(begin, std::min(begin + chunk, end));
+
+	for (std::thread &thread : threads)
+		thread.join();
+}
@@ -0,0 +1,93 @@
+#include "PreintegrationTable.h"
+#include "TransferFunction.h"
+#include "Parallel.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+
+PreintegrationTable::PreintegrationTable() : size(0), textureID(0), dirtyFirst(1), dirtyLast(0), baseStepSize(0.0f)
+{
+}
+
+void PreintegrationTable::update(const TransferFunction &transferFunction, float baseStepSize)
+{
+	int n = TransferFunction::size;
+	bool rebuild = size != n || this->baseStepSize != baseStepSize;
+	if (rebuild)
+	{
+		size = n;
+		this->baseStepSize = baseStepSize;
+		extinction.assign(n, glm::vec4(-1.0f));
+		table.assign(size_t(n) * n, glm::vec4(0.0f));
+	}
+
+	// Opacities are per base step, turn them into extinction coefficients
+	int first = n, last = -1;
+	for (int i = 0; i < n; i++)
+	{
+		glm::vec4 entry = transferFunction.table[i];
+		float alpha = std::min(std::max(entry.a, 0.0f), 0.999f);
+		float tau = -std::log(1.0f - alpha) / baseStepSize;
+		glm::vec4 value(glm::vec3(entry) * tau, tau);
+		if (value != extinction[i])
+		{
+			extinction[i] = value;
+			first = std::min(first, i);
+			last = std::max(last, i);
+		}
+	}
+	if (last < first)
+		return;
+
+	prefix.assign(n + 1, glm::vec4(0.0f));
+	for (int i = 0; i < n; i++)
+		prefix[i + 1] = prefix[i] + extinction[i];
+
+	// An entry changes only if its density range overlaps [first, last], rows
+	// are independent so they are split among the threads
+	parallelFor(0, n, [&](int firstRow, int lastRow) {
+		for (int back = firstRow; back < lastRow; back++)
+			for (int front = 0; front < n; front++)
+			{
+				int lo = std::min(front, back), hi = std::max(front, back);
+				if (hi < first || lo > last)
+					continue;
+				table[size_t(back) * n + front] = (prefix[hi + 1] - prefix[lo]) / float(hi - lo + 1);
+			}
+	});
+
+	dirtyFirst = std::min(dirtyFirst > dirtyLast ? first : dirtyFirst, first);
+	dirtyLast = std::max(dirtyLast, last);
+}
+
+void PreintegrationTable::upload()
+{
+	if (!textureID)
+	{
+		glGenTextures(1, &textureID);
+		glBindTexture(GL_TEXTURE_2D, textureID);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, size, size, 0, GL_RGBA, GL_FLOAT, table.data());
+		dirtyFirst = 1;
+		dirtyLast = 0;
+		return;
+	}
+	if (dirtyFirst > dirtyLast)
+		return;
+
+	// The changed entries are covered by two rectangles:
+	// back in [dirtyFirst, size) with front in [0, dirtyLast] and the transposed one
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, size);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, dirtyFirst, dirtyLast + 1, size - dirtyFirst, GL_RGBA, GL_FLOAT,
+		&table[size_t(dirtyFirst) * size]);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, dirtyFirst, 0, size - dirtyFirst, dirtyLast + 1, GL_RGBA, GL_FLOAT,
+		&table[dirtyFirst]);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+	dirtyFirst = 1;
+	dirtyLast = 0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+class TransferFunction;
+
+// Pre-integrated transfer function. Entry (front, back) stores the average
+// extinction and extinction weighted color of the transfer function over the
+// density range between two consecutive samples, so the shader classifies
+// the whole segment for any step length. The color is the extinction weighted
+// average, attenuated inside the segment as if it were uniform:
+//   alpha = 1 - exp(-avg.a * step), color = avg.rgb / avg.a * alpha
+class PreintegrationTable
+{
+public:
+	/**
+	* Creates an empty table
+	*/
+	PreintegrationTable();
+
+	/**
+	* Integrates the transfer function, only the entries whose density range
+	* overlaps the part of the function that changed are computed again
+	* @param{TransferFunction &} transfer function
+	* @param{float} step at which the function opacities are defined, in the length unit of the shader (voxels)
+	*/
+	void update(const TransferFunction &transferFunction, float baseStepSize);
+
+	/**
+	* Loads the changed entries into the GPU as a RGBA32F 2D texture
+	*/
+	void upload();
+
+	// Entries per axis (same as the transfer function table)
+	int size;
+	// Integrated entries, row = back density, column = front density
+	std::vector<glm::vec4> table;
+	// Index (GPU) of the table texture
+	unsigned int textureID;
+
+private:
+	// Extinction (a) and extinction weighted color (rgb) of every density
+	std::vector<glm::vec4> extinction;
+	// Prefix sums of extinction, entry i holds the sum of the first i densities
+	std::vector<glm::vec4> prefix;
+	// Density range changed by the last update and not uploaded yet (first > last when clean)
+	int dirtyFirst, dirtyLast;
+	// Step used to compute the current extinctions
+	float baseStepSize;
+};
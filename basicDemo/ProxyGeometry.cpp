@@ -0,0 +1,139 @@
+#include "ProxyGeometry.h"
+#include "MacrocellGrid.h"
+#include "Parallel.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <mutex>
+
+namespace
+{
+	// Corners of the face of a cell on each side (-x, +x, -y, +y, -z, +z),
+	// counter clockwise seen from outside the cell
+	const int faceCorners[6][4][3] = {
+		{ { 0, 0, 0 }, { 0, 0, 1 }, { 0, 1, 1 }, { 0, 1, 0 } },
+		{ { 1, 0, 0 }, { 1, 1, 0 }, { 1, 1, 1 }, { 1, 0, 1 } },
+		{ { 0, 0, 0 }, { 1, 0, 0 }, { 1, 0, 1 }, { 0, 0, 1 } },
+		{ { 0, 1, 0 }, { 0, 1, 1 }, { 1, 1, 1 }, { 1, 1, 0 } },
+		{ { 0, 0, 0 }, { 0, 1, 0 }, { 1, 1, 0 }, { 1, 0, 0 } },
+		{ { 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 }, { 0, 1, 1 } } };
+	const int faceNeighbour[6][3] = { { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+}
+
+ProxyGeometry::ProxyGeometry() : faceCount(0), vao(0), vbo(0), ebo(0), indexCount(0), dirty(true), cropFirst(0.0f), cropLast(1.0f)
+{
+}
+
+void ProxyGeometry::markDirty()
+{
+	dirty = true;
+}
+
+bool ProxyGeometry::update(const MacrocellGrid &macrocells, const glm::ivec3 &volumeDim, const std::vector<unsigned char> &visible,
+	const glm::vec3 &cropFirst, const glm::vec3 &cropLast)
+{
+	if (!dirty && visible == this->visible && cropFirst == this->cropFirst && cropLast == this->cropLast)
+		return false;
+	this->visible = visible;
+	this->cropFirst = cropFirst;
+	this->cropLast = cropLast;
+	dirty = false;
+
+	glm::ivec3 count = macrocells.count;
+	glm::vec3 dim(volumeDim);
+	std::vector<unsigned char> occupied = macrocells.occupiedCells(visible, cropFirst * dim, cropLast * dim);
+	auto isOccupied = [&](int x, int y, int z) {
+		if (x < 0 || y < 0 || z < 0 || x >= count.x || y >= count.y || z >= count.z)
+			return false;
+		return occupied[(size_t(z) * count.y + y) * count.x + x] != 0;
+	};
+
+	// Corners (as indices of the (count + 1)^3 lattice) of the boundary quads, per slab of cells
+	glm::ivec3 corners = count + 1;
+	std::vector<unsigned int> quads;
+	std::mutex mutex;
+	parallelFor(0, count.z, [&](int firstZ, int lastZ) {
+		std::vector<unsigned int> slabQuads;
+		for (int z = firstZ; z < lastZ; z++)
+			for (int y = 0; y < count.y; y++)
+				for (int x = 0; x < count.x; x++)
+				{
+					if (!isOccupied(x, y, z))
+						continue;
+					for (int face = 0; face < 6; face++)
+					{
+						const int *n = faceNeighbour[face];
+						if (isOccupied(x + n[0], y + n[1], z + n[2]))
+							continue;
+						for (int c = 0; c < 4; c++)
+						{
+							const int *corner = faceCorners[face][c];
+							slabQuads.push_back(unsigned(((z + corner[2]) * corners.y + y + corner[1]) * corners.x + x + corner[0]));
+						}
+					}
+				}
+		std::lock_guard<std::mutex> lock(mutex);
+		quads.insert(quads.end(), slabQuads.begin(), slabQuads.end());
+	});
+
+	// Shared corners get a single vertex, the last cells can be partial and the
+	// cells cut by the crop box end at its faces
+	std::vector<int> vertexOf(size_t(corners.x) * corners.y * corners.z, -1);
+	std::vector<glm::vec3> vertices;
+	std::vector<unsigned int> indices;
+	indices.reserve(quads.size() / 4 * 6);
+	glm::vec3 cellExtent = glm::vec3(float(macrocells.cellSize)) / glm::vec3(volumeDim);
+	for (size_t q = 0; q < quads.size(); q += 4)
+	{
+		unsigned int quad[4];
+		for (int c = 0; c < 4; c++)
+		{
+			int &vertex = vertexOf[quads[q + c]];
+			if (vertex < 0)
+			{
+				unsigned int corner = quads[q + c];
+				glm::ivec3 lattice(corner % corners.x, (corner / corners.x) % corners.y, corner / (corners.x * corners.y));
+				vertex = int(vertices.size());
+				vertices.push_back(glm::clamp(glm::vec3(lattice) * cellExtent, cropFirst, cropLast) - 0.5f);
+			}
+			quad[c] = unsigned(vertex);
+		}
+		unsigned int triangles[6] = { quad[0], quad[1], quad[2], quad[0], quad[2], quad[3] };
+		indices.insert(indices.end(), triangles, triangles + 6);
+	}
+	faceCount = int(quads.size() / 4);
+	indexCount = int(indices.size());
+
+	if (!vao)
+	{
+		glGenVertexArrays(1, &vao);
+		glGenBuffers(1, &vbo);
+		glGenBuffers(1, &ebo);
+	}
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)0);
+	glBindVertexArray(0);
+	return true;
+}
+
+void ProxyGeometry::draw() const
+{
+	if (!indexCount)
+		return;
+	glBindVertexArray(vao);
+	glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, (void *)0);
+	glBindVertexArray(0);
+}
+
+void ProxyGeometry::release()
+{
+	glDeleteVertexArrays(1, &vao);
+	glDeleteBuffers(1, &vbo);
+	glDeleteBuffers(1, &ebo);
+	vao = vbo = ebo = 0;
+	indexCount = 0;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+class MacrocellGrid;
+
+// Boundary of the union of the macrocells that can change a ray, drawn
+// instead of the bounding cube so the rays enter and leave at occupied
+// space. Faces between two occupied cells are dropped and the corners are
+// shared, so the mesh is closed and indexed. The mesh is not convex: the
+// exit is the farthest back face and the entry the nearest front face
+class ProxyGeometry
+{
+public:
+	/**
+	* Creates an empty mesh
+	*/
+	ProxyGeometry();
+
+	/**
+	* The min/max grid changed, the next update builds the mesh again
+	*/
+	void markDirty();
+
+	/**
+	* Builds and uploads the mesh if the densities that matter, the crop box or the min/max grid changed
+	* @param{MacrocellGrid &} min/max grid
+	* @param{glm::ivec3 &} voxels per axis of the volume
+	* @param{std::vector<unsigned char> &} densities (256 entries) that can change a ray
+	* @param{glm::vec3 &} lower corner of the crop box (texture space)
+	* @param{glm::vec3 &} upper corner of the crop box (texture space)
+	* @returns{bool} true if the mesh was built
+	*/
+	bool update(const MacrocellGrid &macrocells, const glm::ivec3 &volumeDim, const std::vector<unsigned char> &visible,
+		const glm::vec3 &cropFirst, const glm::vec3 &cropLast);
+
+	/**
+	* Draws the mesh, model space spans [-0.5, 0.5] like the unit cube
+	*/
+	void draw() const;
+
+	/**
+	* Deletes the GPU objects
+	*/
+	void release();
+
+	// Quads of the last mesh
+	int faceCount;
+
+private:
+	unsigned int vao, vbo, ebo;
+	int indexCount;
+	bool dirty;
+	// Densities and crop box of the last build
+	std::vector<unsigned char> visible;
+	glm::vec3 cropFirst, cropLast;
+};
@@ -0,0 +1,131 @@
+#include "SamplingRate.h"
+#include "Volume.h"
+#include "MacrocellGrid.h"
+#include "TransferFunction.h"
+#include "Parallel.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+
+const float SamplingRate::tolerance = 1.0f / 32.0f;
+const float SamplingRate::minFactor = 0.5f;
+const float SamplingRate::maxFactor = 8.0f;
+
+SamplingRate::SamplingRate() : count(0), cellSize(0), meanFactor(1.0f), textureID(0), stepVoxels(0.0f)
+{
+}
+
+void SamplingRate::build(const Volume &volume, int cellSize)
+{
+	this->cellSize = cellSize;
+	count = (volume.dim + cellSize - 1) / cellSize;
+	frequency.assign(size_t(count.x) * count.y * count.z, 0.0f);
+	table.clear();
+
+	glm::ivec3 dim = volume.dim;
+	parallelFor(0, count.z, [&](int first, int last) {
+		std::vector<double> sum(size_t(count.x) * count.y), sumSquares(sum.size());
+		std::vector<int> voxels(sum.size());
+		for (int cz = first; cz < last; cz++)
+		{
+			std::fill(sum.begin(), sum.end(), 0.0);
+			std::fill(sumSquares.begin(), sumSquares.end(), 0.0);
+			std::fill(voxels.begin(), voxels.end(), 0);
+			for (int z = cz * cellSize; z < std::min((cz + 1) * cellSize, dim.z); z++)
+				for (int y = 0; y < dim.y; y++)
+				{
+					size_t rowCell = size_t(y / cellSize) * count.x;
+					for (int x = 0; x < dim.x; x++)
+					{
+						// Central differences, the border voxels are repeated
+						float dx = float(volume.voxel(x + 1, y, z) - volume.voxel(x - 1, y, z));
+						float dy = float(volume.voxel(x, y + 1, z) - volume.voxel(x, y - 1, z));
+						float dz = float(volume.voxel(x, y, z + 1) - volume.voxel(x, y, z - 1));
+						double magnitude = 0.5 * std::sqrt(dx * dx + dy * dy + dz * dz);
+						size_t cell = rowCell + x / cellSize;
+						sum[cell] += magnitude;
+						sumSquares[cell] += magnitude * magnitude;
+						voxels[cell]++;
+					}
+				}
+
+			// A few sharp edges raise the bound more than a uniformly rough cell
+			for (size_t cell = 0; cell < sum.size(); cell++)
+			{
+				double mean = sum[cell] / std::max(voxels[cell], 1);
+				double variance = std::max(sumSquares[cell] / std::max(voxels[cell], 1) - mean * mean, 0.0);
+				frequency[size_t(cz) * sum.size() + cell] = float(mean + 2.0 * std::sqrt(variance));
+			}
+		}
+	});
+}
+
+bool SamplingRate::update(const TransferFunction &transferFunction, const MacrocellGrid &macrocells, float stepVoxels)
+{
+	size_t cells = frequency.size();
+	if (!cells || macrocells.minMax.size() != cells * 2)
+		return false;
+	if (transferFunction.table == table && stepVoxels == this->stepVoxels)
+		return false;
+	table = transferFunction.table;
+	this->stepVoxels = stepVoxels;
+
+	// Change of the premultiplied color from each density to the next one
+	int size = int(table.size());
+	std::vector<float> slope(size, 0.0f);
+	for (int i = 0; i + 1 < size; i++)
+	{
+		glm::vec4 a(glm::vec3(table[i]) * table[i].a, table[i].a);
+		glm::vec4 b(glm::vec3(table[i + 1]) * table[i + 1].a, table[i + 1].a);
+		glm::vec4 delta = glm::abs(b - a);
+		slope[i] = std::max(std::max(delta.r, delta.g), std::max(delta.b, delta.a));
+	}
+
+	factors.resize(cells);
+	double factorSum = 0.0;
+	int visibleCells = 0;
+	for (size_t cell = 0; cell < cells; cell++)
+	{
+		int lo = macrocells.minMax[cell * 2], hi = macrocells.minMax[cell * 2 + 1];
+		float maxSlope = 0.0f, maxOpacity = 0.0f;
+		for (int i = lo; i <= hi; i++)
+		{
+			if (i < hi)
+				maxSlope = std::max(maxSlope, slope[i]);
+			maxOpacity = std::max(maxOpacity, table[i].a);
+		}
+
+		// Voxels between samples that keep the change under the tolerance, never under half a voxel
+		float change = frequency[cell] * maxSlope;
+		float distance = change > 0.0f ? std::max(tolerance / change, 0.5f) : 1e30f;
+		float factor = glm::clamp(distance / std::max(stepVoxels, 1e-6f), minFactor, maxFactor);
+		// Whole multiples keep the samples on the regular grid, half a step is the only finer one
+		factor = factor < 1.0f ? minFactor : std::floor(factor);
+		factors[cell] = (unsigned char)(factor * 2.0f);
+		if (maxOpacity > 0.0f)
+		{
+			factorSum += factor;
+			visibleCells++;
+		}
+	}
+	meanFactor = visibleCells ? float(factorSum / visibleCells) : 1.0f;
+
+	if (!textureID)
+		glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_3D, textureID);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage3D(GL_TEXTURE_3D, 0, GL_R8UI, count.x, count.y, count.z, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, factors.data());
+	return true;
+}
+
+void SamplingRate::release()
+{
+	glDeleteTextures(1, &textureID);
+	textureID = 0;
+	table.clear();
+}
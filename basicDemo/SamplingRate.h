@@ -0,0 +1,71 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+class Volume;
+class MacrocellGrid;
+class TransferFunction;
+
+// Sampling rate each macrocell needs. The data frequency of a cell (how fast
+// the density changes per voxel, mean + 2 standard deviations of its gradient
+// magnitudes) is computed once at load, the transfer function adds how fast
+// the classified color changes per density over the value range of the cell.
+// Their product bounds the change between samples, so smooth cells or cells
+// the function maps flat take longer steps and detailed ones take two samples
+// per voxel (the Nyquist rate of the trilinear reconstruction)
+class SamplingRate
+{
+public:
+	/**
+	* Creates an empty grid
+	*/
+	SamplingRate();
+
+	/**
+	* Computes the data frequency of every cell, the slices of cells are computed in parallel
+	* @param{Volume &} source volume
+	* @param{int} voxels per cell side (same cells as the min/max grid)
+	*/
+	void build(const Volume &volume, int cellSize);
+
+	/**
+	* Computes the step factors again if the transfer function or the step changed
+	* @param{TransferFunction &} current transfer function
+	* @param{MacrocellGrid &} min/max grid of the same cells
+	* @param{float} sampling distance the factors multiply (voxels)
+	* @returns{bool} true if the factors were computed and uploaded
+	*/
+	bool update(const TransferFunction &transferFunction, const MacrocellGrid &macrocells, float stepVoxels);
+
+	/**
+	* Deletes the GPU objects
+	*/
+	void release();
+
+	// Largest change of the classified color (premultiplied) allowed between two samples
+	static const float tolerance;
+	// Step factors are kept in [minFactor, maxFactor]
+	static const float minFactor;
+	static const float maxFactor;
+
+	// Cells per axis
+	glm::ivec3 count;
+	// Voxels per cell side
+	int cellSize;
+	// Gradient magnitude bound of every cell (density units per voxel)
+	std::vector<float> frequency;
+	// Step factor of every cell times 2 (half steps are the finest)
+	std::vector<unsigned char> factors;
+	// Mean step factor of the cells that hold a visible density
+	float meanFactor;
+	// Index (GPU) of the R8UI factor texture
+	unsigned int textureID;
+
+	// Version of the frequency estimate, part of the derived data cache key
+	static const int version = 1;
+
+private:
+	// Transfer function and step of the last update
+	std::vector<glm::vec4> table;
+	float stepVoxels;
+};
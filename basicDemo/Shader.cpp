@@ -50,6 +50,29 @@ Shader::Shader(const char *vertexPath, const char *fragmentPath, const char *geo
 	glDeleteShader(geometryID);
 }
 
+Shader::Shader(const char *vertexPath, const char *fragmentPath, const std::vector<std::string> &defines)
+{
+	unsigned vertexID, fragmentID;
+	std::string preamble;
+
+	for (const std::string &define : defines)
+		preamble += "#define " + define + "\n";
+
+	if (!compileShaderCode(vertexPath, shaderType::VERTEX_SHADER, vertexID, preamble))
+		return;
+
+	if (!compileShaderCode(fragmentPath, shaderType::FRAGMENT_SHADER, fragmentID, preamble))
+	{
+		glDeleteShader(vertexID);
+		return;
+	}
+
+	linkProgram(vertexID, fragmentID);
+
+	glDeleteShader(vertexID);
+	glDeleteShader(fragmentID);
+}
+
 Shader::~Shader()
 {
 	glDeleteProgram(ID);
@@ -75,6 +98,16 @@ void Shader::setFloat(const std::string &name, float value) const
 	glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
 }
 
+void Shader::setIVec3(const std::string &name, const glm::ivec3 &value) const
+{
+	glUniform3iv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+}
+
+void Shader::setIVec2(const std::string &name, const glm::ivec2 &value) const
+{
+	glUniform2iv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+}
+
 void Shader::setVec2(const std::string &name, const glm::vec2 &value) const
 {
 	glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
@@ -120,7 +153,7 @@ void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const
 	glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
 }
 
-bool Shader::compileShaderCode(const char *path, shaderType type, unsigned int &shaderID)
+bool Shader::compileShaderCode(const char *path, shaderType type, unsigned int &shaderID, const std::string &defines)
 {
 	std::string shaderCode;
 	std::ifstream shaderFile;
@@ -146,6 +179,15 @@ bool Shader::compileShaderCode(const char *path, shaderType type, unsigned int &
 		return false;
 	}
 
+	// The defines have to go after the #version directive, #line keeps
+	// the compiler error messages pointing to the lines of the file
+	if (!defines.empty())
+	{
+		size_t versionEnd = shaderCode.find('\n', shaderCode.find("#version"));
+		if (versionEnd != std::string::npos)
+			shaderCode.insert(versionEnd + 1, defines + "#line 2\n");
+	}
+
 	const char *code = shaderCode.c_str();
 	std::string stringType;
 	// Creates the shader object in the GPU
@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <vector>
 #include <glm/glm.hpp>
 
 // Types of shader supported by the shader class
@@ -28,6 +29,15 @@ public:
 	*/
 	Shader(const char* vertexPath, const char* fragmentPath, const char* gemotryPath);
 
+	/**
+	* Loads and compiles a shader variant, every define is injected
+	* right after the #version line of both stages
+	* @param{const char*} Path to the vertex shader
+	* @param{const char*} Path to the fragment shader
+	* @param{std::vector<std::string> &} Preprocessor defines ("NAME" or "NAME VALUE")
+	*/
+	Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string> &defines);
+
 	/**
 	* Shader destructor
 	*/
@@ -59,6 +69,20 @@ public:
 	*/
 	void setFloat(const std::string &name, float value) const;
 
+	/**
+	* Sets an ivec3 uniform
+	* @param{std::string &} uniform name
+	* @param{ivec3} value to be set
+	*/
+	void setIVec3(const std::string &name, const glm::ivec3 &value) const;
+
+	/**
+	* Sets an ivec2 uniform
+	* @param{std::string &} uniform name
+	* @param{ivec2} value to be set
+	*/
+	void setIVec2(const std::string &name, const glm::ivec2 &value) const;
+
 	/**
 	* Sets an vec2 uniform
 	* @param{std::string &} uniform name
@@ -138,9 +162,10 @@ private:
 	* @param{const char*} Path to the shader code
 	* @param{shaderType} Type of shader to be compiled
 	* @param{unsigned int &} Shader code ID assigned by the GPU, if the code compiles
+	* @param{std::string &} Preprocessor block injected after the #version line
 	* @returns{bool} Compilation status
 	*/
-	bool compileShaderCode(const char* path, shaderType type, unsigned int &shaderID);
+	bool compileShaderCode(const char* path, shaderType type, unsigned int &shaderID, const std::string &defines = "");
 
 	/**
 	* Links individual shader codes into a shader program
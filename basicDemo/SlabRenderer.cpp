@@ -0,0 +1,129 @@
+#include "SlabRenderer.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+	// The slabs are blended under the accumulated ones, an image starts transparent
+	const float transparent[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+}
+
+SlabRenderer::SlabRenderer() : drawBudget(8.0f), frameBudget(10.0f), slabCount(maxSlabs), drawnSlabs(maxSlabs), frameSlabs(0),
+	depth(0), accumulation(0), size(0), imageTime(0.0)
+{
+	fbo[0] = fbo[1] = 0;
+	color[0] = color[1] = 0;
+}
+
+void SlabRenderer::resize(int width, int height)
+{
+	size = glm::ivec2(width, height);
+	if (!fbo[0])
+	{
+		glGenFramebuffers(2, fbo);
+		glGenTextures(2, color);
+		glGenRenderbuffers(1, &depth);
+	}
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+	GLint drawFramebuffer;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer);
+	for (int i = 0; i < 2; i++)
+	{
+		glBindTexture(GL_TEXTURE_2D, color[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+
+		// Both targets share the depth of the proxy geometry
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color[i], 0);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cout << "ERROR::SLABS The accumulation target is not renderable" << std::endl;
+		glClearBufferfv(GL_COLOR, 0, transparent);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, drawFramebuffer);
+
+	// The next frame starts a new image
+	key.clear();
+	drawnSlabs = slabCount;
+}
+
+bool SlabRenderer::begin(const std::vector<unsigned char> &frameKey)
+{
+	bool restart = frameKey != key;
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo[accumulation]);
+	if (restart)
+	{
+		key = frameKey;
+
+		// Cost of the last image from the slabs measured, it sets how many slabs keep a draw in budget
+		timer.poll(false);
+		if (timer.samples[0] > 0)
+			imageTime = timer.average(0) * slabCount;
+		timer.reset();
+		if (imageTime > 0.0)
+			slabCount = std::min(std::max(int(std::ceil(imageTime / drawBudget)), 1), int(maxSlabs));
+		drawnSlabs = 0;
+
+		glClearBufferfv(GL_COLOR, 0, transparent);
+	}
+	// The depth only pass of the proxy geometry runs every frame
+	const float farDepth = 1.0f;
+	glClearBufferfv(GL_DEPTH, 0, &farDepth);
+	frameSlabs = 0;
+	return restart;
+}
+
+int SlabRenderer::nextSlab()
+{
+	if (drawnSlabs >= slabCount)
+		return -1;
+	// One slab always, more while their measured cost fits the frame (all of
+	// them until the first image is measured)
+	double slabTime = imageTime / slabCount;
+	if (frameSlabs > 0 && (frameSlabs + 1) * slabTime > frameBudget)
+		return -1;
+	frameSlabs++;
+	return drawnSlabs++;
+}
+
+void SlabRenderer::beginSlab()
+{
+	timer.begin(0);
+}
+
+void SlabRenderer::endSlab()
+{
+	timer.end();
+}
+
+bool SlabRenderer::finished() const
+{
+	return drawnSlabs >= slabCount;
+}
+
+void SlabRenderer::complete()
+{
+	accumulation = 1 - accumulation;
+}
+
+void SlabRenderer::present() const
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo[1 - accumulation]);
+	glBlitFramebuffer(0, 0, size.x, size.y, 0, 0, size.x, size.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
+
+void SlabRenderer::release()
+{
+	timer.release();
+	glDeleteFramebuffers(2, fbo);
+	glDeleteTextures(2, color);
+	glDeleteRenderbuffers(1, &depth);
+	fbo[0] = fbo[1] = color[0] = color[1] = depth = 0;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "GpuTimer.h"
+
+// Splits the raycasting of an image into depth slabs perpendicular to the
+// view direction so no single draw runs long. The slabs composite front to
+// back with the under operator into a RGBA16F target, as many per frame as
+// fit the frame budget, and an image can take several frames. The last
+// complete image is shown until the next one is done, and a view that does
+// not change costs no raycasting at all. The number of slabs of an image is
+// picked from the GPU time of the previous one, the first image uses the
+// most slabs since its cost is unknown
+class SlabRenderer
+{
+public:
+	/**
+	* Creates a renderer without targets
+	*/
+	SlabRenderer();
+
+	/**
+	* Allocates the accumulation and complete image targets, the next image starts over
+	* @param{int} window width
+	* @param{int} window height
+	*/
+	void resize(int width, int height);
+
+	/**
+	* Starts a new image if anything that changes it changed, then binds the
+	* accumulation target
+	* @param{std::vector<unsigned char> &} bytes of every setting the image depends on
+	* @returns{bool} true if a new image was started
+	*/
+	bool begin(const std::vector<unsigned char> &frameKey);
+
+	/**
+	* Picks the next slab of the image if the frame budget allows it
+	* @returns{int} slab index [0, slabCount), -1 when the frame is over
+	*/
+	int nextSlab();
+
+	/**
+	* Times the draw of a slab, every draw between beginSlab and endSlab
+	*/
+	void beginSlab();
+	void endSlab();
+
+	/**
+	* @returns{bool} true if every slab of the image was drawn
+	*/
+	bool finished() const;
+
+	/**
+	* Keeps the accumulated image as the one shown, once finished
+	*/
+	void complete();
+
+	/**
+	* Copies the last complete image to the draw frame buffer
+	*/
+	void present() const;
+
+	/**
+	* Deletes the GPU objects
+	*/
+	void release();
+
+	// Longest draw allowed (ms), it bounds the slab count
+	float drawBudget;
+	// GPU time per frame spent on slabs (ms), at least one slab is drawn
+	float frameBudget;
+	// Slabs of the image in progress, maxSlabs until an image was measured
+	int slabCount;
+	// Slabs drawn so far of the image in progress
+	int drawnSlabs;
+	// Slabs drawn in the last frame
+	int frameSlabs;
+	static const int maxSlabs = 64;
+
+private:
+	unsigned int fbo[2], color[2], depth;
+	// Target the image in progress accumulates into, the other holds the complete one
+	int accumulation;
+	glm::ivec2 size;
+	std::vector<unsigned char> key;
+	// GPU time of a whole image (ms), 0 until measured
+	double imageTime;
+	GpuTimer timer;
+};
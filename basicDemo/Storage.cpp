@@ -0,0 +1,171 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "Storage.h"
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool seek64(FILE *file, uint64_t offset)
+{
+#ifdef _WIN32
+	return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+	return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+uint64_t tell64(FILE *file)
+{
+#ifdef _WIN32
+	return (uint64_t)_ftelli64(file);
+#else
+	return (uint64_t)ftello(file);
+#endif
+}
+
+void rleCompress(const unsigned char *in, size_t size, std::vector<unsigned char> &out)
+{
+	out.clear();
+	size_t i = 0;
+	while (i < size)
+	{
+		size_t run = 1;
+		while (i + run < size && run < 128 && in[i + run] == in[i])
+			run++;
+		if (run >= 3)
+		{
+			out.push_back((unsigned char)(1 - int(run)));
+			out.push_back(in[i]);
+			i += run;
+			continue;
+		}
+
+		// Literals until the next run of three
+		size_t start = i;
+		while (i < size && i - start < 128)
+		{
+			if (i + 2 < size && in[i] == in[i + 1] && in[i] == in[i + 2])
+				break;
+			i++;
+		}
+		out.push_back((unsigned char)(i - start - 1));
+		out.insert(out.end(), in + start, in + i);
+	}
+}
+
+bool rleDecompress(const unsigned char *in, size_t size, unsigned char *out, size_t outSize)
+{
+	size_t i = 0, o = 0;
+	while (i < size && o < outSize)
+	{
+		int control = (signed char)in[i++];
+		if (control >= 0)
+		{
+			size_t count = size_t(control) + 1;
+			if (i + count > size || o + count > outSize)
+				return false;
+			memcpy(out + o, in + i, count);
+			i += count;
+			o += count;
+		}
+		else if (control != -128)
+		{
+			size_t count = size_t(1 - control);
+			if (i >= size || o + count > outSize)
+				return false;
+			memset(out + o, in[i++], count);
+			o += count;
+		}
+	}
+	return o == outSize;
+}
+
+bool createDirectory(const char *path)
+{
+#ifdef _WIN32
+	return _mkdir(path) == 0 || errno == EEXIST;
+#else
+	return mkdir(path, 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+MappedFile::MappedFile() : data(NULL), size(0)
+{
+#ifdef _WIN32
+	file = INVALID_HANDLE_VALUE;
+	mapping = NULL;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const char *path)
+{
+	close();
+#ifdef _WIN32
+	file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER length;
+	if (!GetFileSizeEx(file, &length) || length.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+	size = size_t(length.QuadPart);
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	data = mapping ? (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+#else
+	int file = ::open(path, O_RDONLY);
+	if (file < 0)
+		return false;
+	struct stat status;
+	if (fstat(file, &status) == 0 && status.st_size > 0)
+	{
+		size = size_t(status.st_size);
+		void *view = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+		data = view == MAP_FAILED ? NULL : (const unsigned char *)view;
+	}
+	// The mapping keeps the file alive
+	::close(file);
+#endif
+	if (!data)
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (data)
+		UnmapViewOfFile(data);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+	mapping = NULL;
+	file = INVALID_HANDLE_VALUE;
+#else
+	if (data)
+		munmap((void *)data, size);
+#endif
+	data = NULL;
+	size = 0;
+}
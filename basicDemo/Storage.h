@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Helpers shared by the on-disk volume formats
+
+/**
+* Moves a file to a 64 bit position
+* @param{FILE *} file
+* @param{uint64_t} position from the start of the file
+* @returns{bool} true on success
+*/
+bool seek64(FILE *file, uint64_t offset);
+
+/**
+* Position of a file, past 4 GB too
+* @param{FILE *} file
+* @returns{uint64_t} position from the start of the file
+*/
+uint64_t tell64(FILE *file);
+
+/**
+* PackBits run length encoding: a control byte n >= 0 is followed by n + 1
+* literals, n < 0 (but not -128) repeats the next byte 1 - n times
+* @param{const unsigned char *} data to compress
+* @param{size_t} bytes to compress
+* @param{std::vector<unsigned char> &} compressed data (replaced)
+*/
+void rleCompress(const unsigned char *in, size_t size, std::vector<unsigned char> &out);
+
+/**
+* Expands PackBits data
+* @param{const unsigned char *} compressed data
+* @param{size_t} compressed bytes
+* @param{unsigned char *} destination
+* @param{size_t} expected expanded bytes
+* @returns{bool} true if the data expands to exactly outSize bytes
+*/
+bool rleDecompress(const unsigned char *in, size_t size, unsigned char *out, size_t outSize);
+
+/**
+* Creates a directory, an existing one is not an error
+* @param{const char*} path of the directory
+* @returns{bool} true if the directory exists afterwards
+*/
+bool createDirectory(const char *path);
+
+// Read only memory mapping of a whole file
+class MappedFile
+{
+public:
+	/**
+	* Creates an unmapped file
+	*/
+	MappedFile();
+
+	/**
+	* Unmaps the file
+	*/
+	~MappedFile();
+
+	/**
+	* Maps a file
+	* @param{const char*} path of the file
+	* @returns{bool} true if the file exists and could be mapped
+	*/
+	bool open(const char *path);
+
+	/**
+	* Unmaps the file
+	*/
+	void close();
+
+	// Start and bytes of the mapped file
+	const unsigned char *data;
+	size_t size;
+
+private:
+	MappedFile(const MappedFile &);
+	MappedFile &operator=(const MappedFile &);
+
+#ifdef _WIN32
+	void *file;
+	void *mapping;
+#endif
+};
@@ -0,0 +1,136 @@
+#include "TiledVolume.h"
+#include "Volume.h"
+#include "Shader.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <iostream>
+
+TiledVolume::TiledVolume() : count(0), bytes(0), vao(0), volumeDim(0)
+{
+}
+
+bool TiledVolume::create(const Volume &volume, int maxTextureSize, unsigned int cubeVBO)
+{
+	release();
+	volumeDim = volume.dim;
+
+	// As few tiles as the limit allows, all of about the same size
+	int maxCore = maxTextureSize - 2 * ghostVoxels;
+	if (maxCore < 1 || volume.data.size() != volume.voxelCount())
+		return false;
+	count = (volume.dim + maxCore - 1) / maxCore;
+	glm::ivec3 coreSize = (volume.dim + count - 1) / count;
+
+	// The tiles are read in place, the unpack state walks the volume rows
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, volume.dim.x);
+	glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, volume.dim.y);
+	bool ok = true;
+	while (glGetError() != GL_NO_ERROR)
+		;
+	for (int z = 0; z < count.z && ok; z++)
+		for (int y = 0; y < count.y && ok; y++)
+			for (int x = 0; x < count.x && ok; x++)
+			{
+				Tile tile;
+				tile.first = glm::ivec3(x, y, z) * coreSize;
+				tile.size = glm::min(coreSize, volume.dim - tile.first);
+				tile.textureFirst = glm::max(tile.first - ghostVoxels, glm::ivec3(0));
+				tile.textureSize = glm::min(tile.first + tile.size + ghostVoxels, volume.dim) - tile.textureFirst;
+
+				glGenTextures(1, &tile.textureID);
+				glBindTexture(GL_TEXTURE_3D, tile.textureID);
+				// Past the volume border the edge voxels repeat, the same as the single texture
+				glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+				glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+				glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, 0);
+				glPixelStorei(GL_UNPACK_SKIP_PIXELS, tile.textureFirst.x);
+				glPixelStorei(GL_UNPACK_SKIP_ROWS, tile.textureFirst.y);
+				glPixelStorei(GL_UNPACK_SKIP_IMAGES, tile.textureFirst.z);
+				glTexImage3D(GL_TEXTURE_3D, 0, GL_R8, tile.textureSize.x, tile.textureSize.y, tile.textureSize.z, 0, GL_RED, GL_UNSIGNED_BYTE, volume.data.data());
+				tiles.push_back(tile);
+				bytes += size_t(tile.textureSize.x) * tile.textureSize.y * tile.textureSize.z;
+
+				GLenum error = glGetError();
+				if (error != GL_NO_ERROR)
+				{
+					std::cout << "ERROR::TILES Tile " << x << " " << y << " " << z << " could not be allocated (" << error << ")" << std::endl;
+					ok = false;
+				}
+			}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, 0);
+	glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+	glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+	glPixelStorei(GL_UNPACK_SKIP_IMAGES, 0);
+	if (!ok)
+	{
+		release();
+		return false;
+	}
+
+	// The box of a tile is a constant attribute of the draw, the cube is shared
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+	return true;
+}
+
+int TiledVolume::draw(Shader *shader, const glm::vec3 &eye, const glm::vec3 &extent, const glm::vec3 &cropFirst, const glm::vec3 &cropLast)
+{
+	// The tiles form a regular grid, the distance of their centers to the eye is a visibility order
+	glm::vec3 dim(volumeDim);
+	order.clear();
+	for (size_t i = 0; i < tiles.size(); i++)
+	{
+		glm::vec3 center = (glm::vec3(tiles[i].first) + 0.5f * glm::vec3(tiles[i].size)) / dim;
+		glm::vec3 offset = (center - eye) * extent;
+		order.push_back(std::make_pair(glm::dot(offset, offset), int(i)));
+	}
+	std::sort(order.begin(), order.end());
+
+	int drawn = 0;
+	glBindVertexArray(vao);
+	glActiveTexture(GL_TEXTURE0);
+	for (const std::pair<float, int> &entry : order)
+	{
+		const Tile &tile = tiles[entry.second];
+		glm::vec3 first = glm::clamp(glm::vec3(tile.first) / dim, cropFirst, cropLast);
+		glm::vec3 last = glm::clamp(glm::vec3(tile.first + tile.size) / dim, cropFirst, cropLast);
+		if (glm::any(glm::greaterThanEqual(first, last)))
+			continue;
+
+		glBindTexture(GL_TEXTURE_3D, tile.textureID);
+		shader->setVec3("tileFirst", glm::vec3(tile.textureFirst));
+		shader->setVec3("tileSize", glm::vec3(tile.textureSize));
+		glVertexAttrib3f(1, first.x, first.y, first.z);
+		glVertexAttrib3f(2, last.x, last.y, last.z);
+		glDrawArrays(GL_TRIANGLES, 0, 36);
+		drawn++;
+	}
+	glBindVertexArray(0);
+	return drawn;
+}
+
+void TiledVolume::release()
+{
+	for (const Tile &tile : tiles)
+		glDeleteTextures(1, &tile.textureID);
+	tiles.clear();
+	glDeleteVertexArrays(1, &vao);
+	vao = 0;
+	count = glm::ivec3(0);
+	bytes = 0;
+}
+
+bool TiledVolume::loaded() const
+{
+	return !tiles.empty();
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+
+class Volume;
+class Shader;
+
+// Volume too large for a single 3D texture, split into a grid of tiles of at
+// most the driver limit. Every tile texture repeats ghostVoxels of its
+// neighbours on each side, so trilinear filtering and the central difference
+// gradients at a tile face read the same voxels as inside the tile. The
+// tiles are drawn as boxes sorted front to back with the brick raycaster,
+// whose ray segments composite across boxes with the under operator
+class TiledVolume
+{
+public:
+	/**
+	* Creates an empty tile grid
+	*/
+	TiledVolume();
+
+	/**
+	* Splits the volume into tiles and loads each one into its own R8 3D texture
+	* straight from the volume data (no copy)
+	* @param{Volume &} source volume
+	* @param{int} voxels per side of the largest texture, ghost voxels included
+	* @param{unsigned int} vertex buffer of the unit cube (36 vertices, model space [-0.5, 0.5])
+	* @returns{bool} true if every tile could be allocated, on failure nothing is kept
+	*/
+	bool create(const Volume &volume, int maxTextureSize, unsigned int cubeVBO);
+
+	/**
+	* Draws the tiles cut to the crop box front to back, one draw per tile with
+	* its texture bound to unit 0 and its placement set on the raycast shader
+	* @param{Shader *} raycast shader (brick and tiled variant), in use
+	* @param{glm::vec3 &} eye position in texture space (the cube spans [0, 1])
+	* @param{glm::vec3 &} size of the volume box, the eye distances are measured in it
+	* @param{glm::vec3 &} lower corner of the crop box (texture space)
+	* @param{glm::vec3 &} upper corner of the crop box (texture space)
+	* @returns{int} tiles drawn
+	*/
+	int draw(Shader *shader, const glm::vec3 &eye, const glm::vec3 &extent, const glm::vec3 &cropFirst, const glm::vec3 &cropLast);
+
+	/**
+	* Deletes the tile textures
+	*/
+	void release();
+
+	/**
+	* @returns{bool} true if the volume is held by the tiles
+	*/
+	bool loaded() const;
+
+	// Voxels repeated from the neighbours on each side of a tile
+	static const int ghostVoxels = 2;
+
+	struct Tile
+	{
+		// First voxel and voxels per axis of the part of the volume the tile draws
+		glm::ivec3 first;
+		glm::ivec3 size;
+		// First voxel and voxels per axis of the texture (ghost voxels included, cut at the volume border)
+		glm::ivec3 textureFirst;
+		glm::ivec3 textureSize;
+		unsigned int textureID;
+	};
+
+	// Tiles per axis
+	glm::ivec3 count;
+	std::vector<Tile> tiles;
+	// Texture memory of all the tiles
+	size_t bytes;
+
+private:
+	unsigned int vao;
+	glm::ivec3 volumeDim;
+	// Per draw sort buffers (squared eye distance and tile index)
+	std::vector<std::pair<float, int> > order;
+};
@@ -0,0 +1,482 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "TimeSeries.h"
+#include "MacrocellGrid.h"
+#include "Volume.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	std::string stepPath(const std::string &pattern, int step)
+	{
+		char path[1024];
+		snprintf(path, sizeof(path), pattern.c_str(), step);
+		return path;
+	}
+}
+
+TimeSeries::TimeSeries() : dim(0), count(0), rate(10.0f), playing(false), currentStep(-1), shownSteps(0), droppedSteps(0), lateFrames(0),
+	bytesRead(0), bytesUploaded(0), deltaMode(false), cellSize(0), front(0), backPending(false), backSequence(-1), lastSequence(-1),
+	nextSequence(0), startTime(0.0), startSequence(0), running(false)
+{
+	textures[0] = textures[1] = 0;
+}
+
+TimeSeries::~TimeSeries()
+{
+	close();
+}
+
+bool TimeSeries::open(const char *pattern, int count, const glm::ivec3 &dim, int cellSize, int prefetch)
+{
+	close();
+	this->pattern = pattern;
+	this->count = count;
+	this->dim = dim;
+	this->cellSize = cellSize;
+	deltaMode = false;
+
+	FILE *first = fopen(stepPath(this->pattern, 0).c_str(), "rb");
+	if (!first || count <= 0)
+	{
+		if (first)
+			fclose(first);
+		return false;
+	}
+	fclose(first);
+
+	createObjects(2, prefetch);
+	running = true;
+	reader = std::thread(&TimeSeries::readerLoop, this);
+	return true;
+}
+
+bool TimeSeries::openDeltas(const char *path, int cellSize, int prefetch)
+{
+	close();
+	if (!deltas.open(path))
+		return false;
+	count = deltas.stepCount;
+	dim = deltas.dim;
+	this->cellSize = cellSize;
+	deltaMode = true;
+
+	createObjects(1, prefetch);
+	running = true;
+	reader = std::thread(&TimeSeries::readerLoop, this);
+	return true;
+}
+
+void TimeSeries::createObjects(int textureCount, int prefetch)
+{
+	// Black until the first timestep arrives
+	size_t bytes = size_t(dim.x) * dim.y * dim.z;
+	std::vector<unsigned char> empty(bytes, 0);
+	if (!textures[0])
+		glGenTextures(2, textures);
+	for (int i = 0; i < textureCount; i++)
+	{
+		glBindTexture(GL_TEXTURE_3D, textures[i]);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, 0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage3D(GL_TEXTURE_3D, 0, GL_R8, dim.x, dim.y, dim.z, 0, GL_RED, GL_UNSIGNED_BYTE, empty.data());
+	}
+
+	staging.resize(std::max(prefetch, 1));
+	for (Staging &slot : staging)
+	{
+		glGenBuffers(1, &slot.pixelBuffer);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pixelBuffer);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+		slot.mapped = NULL;
+		slot.sequence = -1;
+		slot.keyframe = true;
+		slot.state = Staging::FREE;
+		slot.valid = false;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	front = 0;
+	backPending = false;
+	lastSequence = -1;
+	nextSequence = 0;
+	currentStep = -1;
+	shownSteps = droppedSteps = lateFrames = 0;
+	bytesRead = bytesUploaded = 0;
+	startSequence = 0;
+	playing = true;
+	startTime = -1.0;
+}
+
+void TimeSeries::close()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	wake.notify_all();
+	if (reader.joinable())
+		reader.join();
+	requests.clear();
+}
+
+void TimeSeries::setPlaying(bool play, double now)
+{
+	if (play && !playing)
+	{
+		// Resume from the timestep shown
+		startTime = now;
+		startSequence = lastSequence + 1;
+	}
+	playing = play;
+}
+
+bool TimeSeries::update(double now, MacrocellGrid &macrocells)
+{
+	if (staging.empty())
+		return false;
+	if (startTime < 0.0)
+		startTime = now;
+
+	// Timestep that should be on screen, a paused series keeps the last one
+	long long due = playing ? startSequence + (long long)std::floor((now - startTime) * rate) : lastSequence;
+	if (deltaMode)
+	{
+		bool changed = updateDeltas(due, macrocells);
+		requestSteps(playing ? due : lastSequence + 1);
+		return changed;
+	}
+
+	// The upload started last frame has had a frame to complete
+	bool changed = false;
+	if (backPending)
+	{
+		front = 1 - front;
+		backPending = false;
+		currentStep = int(backSequence % count);
+		macrocells.minMax.swap(backMinMax);
+		macrocells.upload();
+		shownSteps++;
+		changed = true;
+		if (currentStep == count - 1)
+			report();
+	}
+
+	// Newest read timestep that is due, older ones are too late to be shown
+	int chosen = -1;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (int i = 0; i < int(staging.size()); i++)
+		{
+			Staging &slot = staging[i];
+			if (slot.state != Staging::READY || slot.sequence > due)
+				continue;
+			if (chosen < 0 || slot.sequence > staging[chosen].sequence)
+				chosen = i;
+		}
+		for (Staging &slot : staging)
+			if (slot.state == Staging::READY && chosen >= 0 && slot.sequence < staging[chosen].sequence)
+				slot.state = Staging::FREE;
+	}
+
+	for (Staging &slot : staging)
+		if (slot.state == Staging::FREE && slot.mapped)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pixelBuffer);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			slot.mapped = NULL;
+		}
+
+	if (chosen >= 0)
+	{
+		Staging &slot = staging[chosen];
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pixelBuffer);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		slot.mapped = NULL;
+		if (slot.valid)
+		{
+			// Copied from the buffer by the GPU, the call returns immediately
+			glBindTexture(GL_TEXTURE_3D, textures[1 - front]);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, dim.x, dim.y, dim.z, GL_RED, GL_UNSIGNED_BYTE, 0);
+			bytesUploaded += size_t(dim.x) * dim.y * dim.z;
+			backPending = true;
+			backSequence = slot.sequence;
+			backMinMax.swap(slot.minMax);
+		}
+		droppedSteps += std::max(slot.sequence - lastSequence - 1, 0LL);
+		lastSequence = slot.sequence;
+		slot.state = Staging::FREE;
+	}
+	else if (playing && due > lastSequence && lastSequence >= 0)
+		lateFrames++;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	requestSteps(playing ? due : lastSequence + 1);
+	return changed;
+}
+
+bool TimeSeries::updateDeltas(long long due, MacrocellGrid &macrocells)
+{
+	// Every read timestep is applied in order, a late frame applies several
+	int applied = 0;
+	while (true)
+	{
+		// The reader fills the buffers in request order, the oldest ready one is next
+		int chosen = -1;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (int i = 0; i < int(staging.size()); i++)
+				if (staging[i].state == Staging::READY && (chosen < 0 || staging[i].sequence < staging[chosen].sequence))
+					chosen = i;
+		}
+		if (chosen < 0 || staging[chosen].sequence > due)
+			break;
+
+		Staging &slot = staging[chosen];
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pixelBuffer);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		slot.mapped = NULL;
+		if (slot.valid)
+		{
+			glBindTexture(GL_TEXTURE_3D, textures[0]);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			if (slot.keyframe)
+			{
+				glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, dim.x, dim.y, dim.z, GL_RED, GL_UNSIGNED_BYTE, 0);
+				bytesUploaded += size_t(dim.x) * dim.y * dim.z;
+				macrocells.minMax.swap(slot.minMax);
+				macrocells.upload();
+			}
+			else
+			{
+				// The changed bricks are packed one after the other in the buffer
+				size_t offset = 0;
+				for (int brick : slot.bricks)
+				{
+					glm::ivec3 origin, extent;
+					deltas.brickBox(brick, origin, extent);
+					glTexSubImage3D(GL_TEXTURE_3D, 0, origin.x, origin.y, origin.z, extent.x, extent.y, extent.z,
+						GL_RED, GL_UNSIGNED_BYTE, (void *)offset);
+					offset += size_t(extent.x) * extent.y * extent.z;
+				}
+				bytesUploaded += offset;
+
+				// Only the cells around the changed bricks, as one box
+				glm::ivec3 first(INT_MAX), last(-1);
+				for (size_t i = 0; i < slot.cells.size(); i++)
+				{
+					int cell = slot.cells[i];
+					glm::ivec3 coordinates(cell % macrocells.count.x, (cell / macrocells.count.x) % macrocells.count.y,
+						cell / (macrocells.count.x * macrocells.count.y));
+					macrocells.minMax[size_t(cell) * 2] = slot.minMax[i * 2];
+					macrocells.minMax[size_t(cell) * 2 + 1] = slot.minMax[i * 2 + 1];
+					first = glm::min(first, coordinates);
+					last = glm::max(last, coordinates);
+				}
+				if (!slot.cells.empty())
+					macrocells.uploadCells(first, last);
+			}
+		}
+
+		droppedSteps += std::max(slot.sequence - lastSequence - 1, 0LL);
+		lastSequence = slot.sequence;
+		slot.state = Staging::FREE;
+		applied++;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if (applied == 0)
+	{
+		if (playing && due > lastSequence && lastSequence >= 0)
+			lateFrames++;
+		return false;
+	}
+
+	// Only the last timestep applied reaches the screen
+	droppedSteps += applied - 1;
+	shownSteps++;
+	currentStep = int(lastSequence % count);
+	if (currentStep == count - 1)
+		report();
+	return true;
+}
+
+void TimeSeries::requestSteps(long long due)
+{
+	if (deltaMode)
+	{
+		// Deltas need the previous timestep, a late series can only jump to a keyframe
+		long long keyframe = due - (due % count) % deltas.keyframeInterval;
+		nextSequence = std::max(nextSequence, keyframe);
+	}
+	else
+	{
+		// Timesteps already late are skipped instead of read
+		nextSequence = std::max(nextSequence, std::max(due, lastSequence + 1));
+	}
+	size_t bytes = size_t(dim.x) * dim.y * dim.z;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	for (int i = 0; i < int(staging.size()); i++)
+	{
+		Staging &slot = staging[i];
+		if (slot.state != Staging::FREE)
+			continue;
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pixelBuffer);
+		// Invalidating gives a new buffer if the GPU still reads the old one
+		slot.mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (!slot.mapped)
+			continue;
+		slot.sequence = nextSequence++;
+		slot.state = Staging::READING;
+		requests.push_back(i);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	wake.notify_one();
+}
+
+void TimeSeries::readerLoop()
+{
+	Volume step;
+	MacrocellGrid grid;
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		wake.wait(lock, [this] { return !running || !requests.empty(); });
+		if (!running)
+			return;
+
+		int index = requests.front();
+		requests.pop_front();
+		Staging &slot = staging[index];
+		lock.unlock();
+
+		bool valid;
+		uint64_t read;
+		if (deltaMode)
+		{
+			uint64_t before = deltas.bytesRead;
+			valid = readDelta(slot, step, grid);
+			read = deltas.bytesRead - before;
+		}
+		else
+		{
+			// Read into main memory first, the mapped buffer is slow to read back
+			valid = step.loadRaw(stepPath(pattern, int(slot.sequence % count)).c_str(), dim);
+			read = step.data.size();
+			if (valid)
+			{
+				grid.build(step, cellSize);
+				memcpy(slot.mapped, step.data.data(), step.data.size());
+				slot.keyframe = true;
+				slot.minMax.swap(grid.minMax);
+			}
+		}
+		if (!valid)
+			std::cout << "ERROR::TIMESERIES Cannot read timestep " << slot.sequence % count << std::endl;
+
+		lock.lock();
+		bytesRead += read;
+		slot.valid = valid;
+		slot.state = Staging::READY;
+	}
+}
+
+bool TimeSeries::readDelta(Staging &slot, Volume &current, MacrocellGrid &grid)
+{
+	int step = int(slot.sequence % count);
+	if (!deltas.readStep(step, current, slot.bricks))
+		return false;
+
+	slot.keyframe = deltas.isKeyframe(step);
+	slot.cells.clear();
+	if (slot.keyframe)
+	{
+		grid.build(current, cellSize);
+		slot.minMax = grid.minMax;
+		memcpy(slot.mapped, current.data.data(), current.data.size());
+		return true;
+	}
+
+	// Pack the changed bricks for the upload
+	unsigned char *out = (unsigned char *)slot.mapped;
+	std::vector<char> dirty(size_t(grid.count.x) * grid.count.y * grid.count.z, 0);
+	for (int brick : slot.bricks)
+	{
+		glm::ivec3 origin, extent;
+		deltas.brickBox(brick, origin, extent);
+		for (int z = 0; z < extent.z; z++)
+			for (int y = 0; y < extent.y; y++)
+			{
+				memcpy(out, &current.data[(size_t(origin.z + z) * dim.y + origin.y + y) * dim.x + origin.x], extent.x);
+				out += extent.x;
+			}
+
+		// Cells include one voxel of their neighbours, the border cells change too
+		glm::ivec3 firstCell = glm::max((origin - 1) / cellSize, glm::ivec3(0));
+		glm::ivec3 lastCell = glm::min((origin + extent) / cellSize, grid.count - 1);
+		for (int cz = firstCell.z; cz <= lastCell.z; cz++)
+			for (int cy = firstCell.y; cy <= lastCell.y; cy++)
+				for (int cx = firstCell.x; cx <= lastCell.x; cx++)
+					dirty[(size_t(cz) * grid.count.y + cy) * grid.count.x + cx] = 1;
+	}
+
+	slot.minMax.clear();
+	for (int cz = 0; cz < grid.count.z; cz++)
+		for (int cy = 0; cy < grid.count.y; cy++)
+			for (int cx = 0; cx < grid.count.x; cx++)
+			{
+				int cell = (cz * grid.count.y + cy) * grid.count.x + cx;
+				if (!dirty[cell])
+					continue;
+				grid.updateCell(current, glm::ivec3(cx, cy, cz));
+				slot.cells.push_back(cell);
+				slot.minMax.push_back(grid.minMax[size_t(cell) * 2]);
+				slot.minMax.push_back(grid.minMax[size_t(cell) * 2 + 1]);
+			}
+	return true;
+}
+
+void TimeSeries::report() const
+{
+	std::cout << "serie: " << shownSteps << " pasos mostrados, " << droppedSteps << " descartados, "
+		<< lateFrames << " cuadros con el paso atrasado, " << (bytesRead >> 20) << " MB leidos, "
+		<< (bytesUploaded >> 20) << " MB subidos" << std::endl;
+}
+
+void TimeSeries::release()
+{
+	for (Staging &slot : staging)
+	{
+		if (slot.mapped)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pixelBuffer);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+		glDeleteBuffers(1, &slot.pixelBuffer);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	staging.clear();
+	if (textures[0])
+		glDeleteTextures(2, textures);
+	textures[0] = textures[1] = 0;
+	deltas.close();
+}
+
+unsigned int TimeSeries::textureID() const
+{
+	return textures[front];
+}
@@ -0,0 +1,196 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+#include "DeltaSeries.h"
+
+class MacrocellGrid;
+class Volume;
+
+// Time varying volume played back at a fixed rate. A reader thread reads the
+// upcoming timesteps (one raw file each) and builds their macrocells while
+// the render thread shows the current one. The reader writes straight into
+// mapped pixel buffer objects, the render thread only unmaps them and starts
+// an asynchronous upload into the back texture, which is shown the next
+// frame, so the render thread never waits for the disk or the GPU.
+// A delta encoded series keeps a single texture instead, the reader applies
+// every timestep to its copy of the volume and only the changed bricks and
+// the macrocells around them are uploaded
+class TimeSeries
+{
+public:
+	/**
+	* Creates a closed series
+	*/
+	TimeSeries();
+
+	/**
+	* Stops the reader thread
+	*/
+	~TimeSeries();
+
+	/**
+	* Opens a series of raw unsigned byte files and starts the reader thread,
+	* needs a current GL context
+	* @param{const char*} printf pattern of the file names, formatted with the timestep (e.g. "flow_%03d.raw")
+	* @param{int} number of timesteps
+	* @param{glm::ivec3 &} voxels per axis of every timestep
+	* @param{int} voxels per macrocell side
+	* @param{int} timesteps read ahead of the one shown
+	* @returns{bool} true if the first timestep exists
+	*/
+	bool open(const char *pattern, int count, const glm::ivec3 &dim, int cellSize, int prefetch);
+
+	/**
+	* Opens a delta encoded series (.bdts) and starts the reader thread, needs
+	* a current GL context. Late timesteps cannot be skipped, they are applied
+	* in the same frame unless a keyframe lets the reader jump ahead
+	* @param{const char*} path of the series
+	* @param{int} voxels per macrocell side
+	* @param{int} timesteps read ahead of the one shown
+	* @returns{bool} true if the series could be opened
+	*/
+	bool openDeltas(const char *path, int cellSize, int prefetch);
+
+	/**
+	* Stops the reader thread
+	*/
+	void close();
+
+	/**
+	* Starts or pauses the playback
+	* @param{bool} true to play
+	* @param{double} current time in seconds
+	*/
+	void setPlaying(bool play, double now);
+
+	/**
+	* Shows the timestep uploaded last frame, starts the upload of the one due
+	* now if it has been read and hands the free buffers to the reader thread
+	* @param{double} current time in seconds
+	* @param{MacrocellGrid &} grid updated with the macrocells of the shown timestep
+	* @returns{bool} true if a new timestep is shown
+	*/
+	bool update(double now, MacrocellGrid &macrocells);
+
+	/**
+	* Deletes the GPU objects
+	*/
+	void release();
+
+	/**
+	* Texture of the timestep shown
+	* @returns{unsigned int} GPU index of the 3D texture
+	*/
+	unsigned int textureID() const;
+
+	// Voxels per axis
+	glm::ivec3 dim;
+	// Number of timesteps
+	int count;
+	// Timesteps per second
+	float rate;
+	bool playing;
+	// Timestep shown (file index)
+	int currentStep;
+	// Timesteps shown, skipped because they were read too late, and frames the due timestep was not ready
+	long long shownSteps;
+	long long droppedSteps;
+	long long lateFrames;
+	// Bytes read from disk and uploaded to the GPU
+	unsigned long long bytesRead;
+	unsigned long long bytesUploaded;
+
+private:
+	// A pixel buffer and the timestep it holds
+	struct Staging
+	{
+		enum State { FREE, READING, READY };
+		unsigned int pixelBuffer;
+		// Write only view of the buffer, set while the buffer is mapped
+		void *mapped;
+		// Timestep, counting the loops (the file is sequence % count)
+		long long sequence;
+		// The whole volume is in the buffer, otherwise only the bricks
+		bool keyframe;
+		std::vector<int> bricks;
+		// Macrocells of the timestep, every cell for a keyframe, otherwise
+		// the min/max of the listed cells
+		std::vector<unsigned char> minMax;
+		std::vector<int> cells;
+		State state;
+		// The file could be read
+		bool valid;
+	};
+
+	/**
+	* Reader thread body
+	*/
+	void readerLoop();
+
+	/**
+	* Maps the free pixel buffers and asks the reader to fill them
+	* @param{long long} first timestep worth reading
+	*/
+	void requestSteps(long long due);
+
+	/**
+	* Creates the textures and the pixel buffers, resets the playback
+	* @param{int} number of textures (2 to alternate, 1 for deltas)
+	* @param{int} number of pixel buffers
+	*/
+	void createObjects(int textureCount, int prefetch);
+
+	/**
+	* Shows the next timesteps of a delta encoded series
+	* @param{long long} timestep due now
+	* @param{MacrocellGrid &} grid to update
+	* @returns{bool} true if a new timestep is shown
+	*/
+	bool updateDeltas(long long due, MacrocellGrid &macrocells);
+
+	/**
+	* Reads a timestep of a delta encoded series into a staging buffer
+	* @param{Staging &} destination, its sequence is read
+	* @param{Volume &} reader copy of the volume, holds the previous timestep
+	* @param{MacrocellGrid &} reader macrocells of the volume
+	* @returns{bool} true if the timestep could be read
+	*/
+	bool readDelta(Staging &slot, Volume &current, MacrocellGrid &grid);
+
+	/**
+	* Reports the playback counters
+	*/
+	void report() const;
+
+	std::string pattern;
+	// Source of a delta encoded series
+	DeltaSeries deltas;
+	bool deltaMode;
+	int cellSize;
+	std::vector<Staging> staging;
+	unsigned int textures[2];
+	// Texture shown, the other one receives the next timestep
+	int front;
+	// An upload into the back texture was started last frame
+	bool backPending;
+	long long backSequence;
+	std::vector<unsigned char> backMinMax;
+	// Last timestep uploaded and next one to read
+	long long lastSequence;
+	long long nextSequence;
+	// Playback clock, the timestep due at time t is startSequence + (t - startTime) * rate
+	double startTime;
+	long long startSequence;
+
+	std::thread reader;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool running;
+	// Staging slots to fill (reader thread input)
+	std::deque<int> requests;
+};
@@ -0,0 +1,88 @@
+#include "TransferFunction.h"
+#include <glad/glad.h>
+#include <algorithm>
+
+TransferFunction::TransferFunction() : textureID(0), dirtyFirst(1), dirtyLast(0)
+{
+	setControlPoints({
+		{ 0.0f, glm::vec4(0.0f, 0.0f, 0.0f, 0.0f) },
+		{ 1.0f, glm::vec4(1.0f, 1.0f, 1.0f, 1.0f) } });
+}
+
+glm::ivec2 TransferFunction::setControlPoints(const std::vector<ControlPoint> &controlPoints)
+{
+	points = controlPoints;
+	glm::ivec2 changed = evaluate();
+	if (changed.x <= changed.y)
+	{
+		dirtyFirst = dirtyFirst > dirtyLast ? changed.x : std::min(dirtyFirst, changed.x);
+		dirtyLast = std::max(dirtyLast, changed.y);
+	}
+	return changed;
+}
+
+glm::ivec2 TransferFunction::evaluate()
+{
+	std::vector<glm::vec4> previous(size, glm::vec4(0.0f));
+	previous.swap(table);
+	previous.resize(size, glm::vec4(-1.0f));
+
+	for (int i = 0; i < size && !points.empty(); i++)
+	{
+		float density = float(i) / (size - 1);
+
+		// Constant outside the first and last control points
+		if (density <= points.front().density)
+		{
+			table[i] = points.front().color;
+			continue;
+		}
+		if (density >= points.back().density)
+		{
+			table[i] = points.back().color;
+			continue;
+		}
+
+		size_t next = 1;
+		while (points[next].density < density)
+			next++;
+		const ControlPoint &a = points[next - 1];
+		const ControlPoint &b = points[next];
+		float span = b.density - a.density;
+		float weight = span > 0.0f ? (density - a.density) / span : 1.0f;
+		table[i] = glm::mix(a.color, b.color, weight);
+	}
+
+	glm::ivec2 changed(size, -1);
+	for (int i = 0; i < size; i++)
+		if (table[i] != previous[i])
+		{
+			changed.x = std::min(changed.x, i);
+			changed.y = i;
+		}
+	return changed;
+}
+
+void TransferFunction::upload()
+{
+	if (!textureID)
+	{
+		glGenTextures(1, &textureID);
+		glBindTexture(GL_TEXTURE_1D, textureID);
+		glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA16F, size, 0, GL_RGBA, GL_FLOAT, table.data());
+		dirtyFirst = 1;
+		dirtyLast = 0;
+		return;
+	}
+	if (dirtyFirst > dirtyLast)
+		return;
+
+	// Dragging a control point only touches the entries between its neighbours
+	glBindTexture(GL_TEXTURE_1D, textureID);
+	glTexSubImage1D(GL_TEXTURE_1D, 0, dirtyFirst, dirtyLast - dirtyFirst + 1, GL_RGBA, GL_FLOAT, &table[dirtyFirst]);
+	dirtyFirst = 1;
+	dirtyLast = 0;
+}
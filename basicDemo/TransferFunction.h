@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+// Transfer function node, colors are interpolated linearly between nodes
+struct ControlPoint
+{
+	// Normalized density [0, 1]
+	float density;
+	// Color and opacity (opacity per base sample step)
+	glm::vec4 color;
+};
+
+// Piecewise linear transfer function sampled into a 256 entry RGBA table
+class TransferFunction
+{
+public:
+	/**
+	* Creates the default ramp (color and opacity equal to the density)
+	*/
+	TransferFunction();
+
+	/**
+	* Replaces the control points and samples the table again
+	* @param{std::vector<ControlPoint> &} control points, sorted by density
+	* @returns{glm::ivec2} first and last table entries that changed (x > y if none)
+	*/
+	glm::ivec2 setControlPoints(const std::vector<ControlPoint> &controlPoints);
+
+	/**
+	* Loads the table into the GPU as a 1D RGBA texture, once created only
+	* the entries changed since the last upload are sent
+	*/
+	void upload();
+
+	// Entries of the table
+	static const int size = 256;
+
+	// Control points sorted by density
+	std::vector<ControlPoint> points;
+	// Sampled colors and opacities
+	std::vector<glm::vec4> table;
+	// Index (GPU) of the table texture
+	unsigned int textureID;
+
+private:
+	/**
+	* Samples the control points into the table
+	* @returns{glm::ivec2} first and last entries that changed (x > y if none)
+	*/
+	glm::ivec2 evaluate();
+
+	// Entries changed and not uploaded yet (first > last when clean)
+	int dirtyFirst, dirtyLast;
+};
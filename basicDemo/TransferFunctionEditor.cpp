@@ -0,0 +1,194 @@
+#include "TransferFunctionEditor.h"
+#include "Shader.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace
+{
+	// Pixels from a control point that still pick it
+	const float pickRadius = 6.0f;
+	// Pixels of the color strip under the curve
+	const float stripHeight = 10.0f;
+
+	const glm::vec3 palette[] = {
+		glm::vec3(1.0f, 1.0f, 1.0f),
+		glm::vec3(0.9f, 0.2f, 0.1f),
+		glm::vec3(1.0f, 0.6f, 0.1f),
+		glm::vec3(1.0f, 0.9f, 0.4f),
+		glm::vec3(0.3f, 0.8f, 0.3f),
+		glm::vec3(0.2f, 0.7f, 1.0f),
+		glm::vec3(0.3f, 0.3f, 0.9f),
+		glm::vec3(0.8f, 0.3f, 0.8f) };
+	const int paletteSize = sizeof(palette) / sizeof(palette[0]);
+
+	// Color of the control points at a density, same interpolation as the table
+	glm::vec3 colorAt(const std::vector<ControlPoint> &points, float density)
+	{
+		if (points.empty())
+			return glm::vec3(1.0f);
+		if (density <= points.front().density)
+			return glm::vec3(points.front().color);
+		for (size_t next = 1; next < points.size(); next++)
+			if (points[next].density >= density)
+			{
+				const ControlPoint &a = points[next - 1];
+				const ControlPoint &b = points[next];
+				float span = b.density - a.density;
+				return glm::mix(glm::vec3(a.color), glm::vec3(b.color), span > 0.0f ? (density - a.density) / span : 1.0f);
+			}
+		return glm::vec3(points.back().color);
+	}
+}
+
+TransferFunctionEditor::TransferFunctionEditor() : visible(false), selected(-1), histogramTextureID(0), dragging(false), paletteIndex(1)
+{
+}
+
+void TransferFunctionEditor::setHistogram(const std::vector<uint64_t> &bins)
+{
+	// The largest bin is usually the background, the heights are relative to the second one
+	std::vector<uint64_t> sorted(bins);
+	std::sort(sorted.begin(), sorted.end());
+	uint64_t reference = sorted.size() > 1 ? sorted[sorted.size() - 2] : sorted.empty() ? 0 : sorted.back();
+	float scale = reference ? 1.0f / std::log1p(float(reference)) : 0.0f;
+
+	std::vector<float> heights(bins.size());
+	for (size_t i = 0; i < bins.size(); i++)
+		heights[i] = std::min(std::log1p(float(bins[i])) * scale, 1.0f);
+
+	if (!histogramTextureID)
+		glGenTextures(1, &histogramTextureID);
+	glBindTexture(GL_TEXTURE_1D, histogramTextureID);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexImage1D(GL_TEXTURE_1D, 0, GL_R32F, GLsizei(heights.size()), 0, GL_RED, GL_FLOAT, heights.data());
+}
+
+bool TransferFunctionEditor::mouse(const glm::vec2 &cursor, bool pressed, const glm::ivec2 &windowSize, std::vector<ControlPoint> &points)
+{
+	if (!visible || !pressed)
+	{
+		dragging = false;
+		return false;
+	}
+
+	glm::vec4 rect = rectangle(windowSize);
+	float curveHeight = rect.w - stripHeight;
+	// Density and opacity under the cursor
+	glm::vec2 value((cursor.x - rect.x) / rect.z, 1.0f - (cursor.y - rect.y) / curveHeight);
+	value = glm::clamp(value, glm::vec2(0.0f), glm::vec2(1.0f));
+
+	if (!dragging)
+	{
+		if (cursor.x < rect.x || cursor.x > rect.x + rect.z || cursor.y < rect.y || cursor.y > rect.y + rect.w)
+			return false;
+		dragging = true;
+
+		selected = -1;
+		float closest = pickRadius;
+		for (size_t i = 0; i < points.size(); i++)
+		{
+			glm::vec2 point(rect.x + points[i].density * rect.z, rect.y + (1.0f - points[i].color.a) * curveHeight);
+			float distance = glm::distance(point, cursor);
+			if (distance <= closest)
+			{
+				selected = int(i);
+				closest = distance;
+			}
+		}
+		if (selected >= 0 || int(points.size()) >= maxPoints)
+			return false;
+
+		// A new point keeps the color the function already had at its density
+		ControlPoint point = { value.x, glm::vec4(colorAt(points, value.x), value.y) };
+		auto position = std::upper_bound(points.begin(), points.end(), point,
+			[](const ControlPoint &a, const ControlPoint &b) { return a.density < b.density; });
+		selected = int(points.insert(position, point) - points.begin());
+		return true;
+	}
+
+	if (selected < 0 || selected >= int(points.size()))
+		return false;
+	ControlPoint &point = points[selected];
+	float lowest = selected > 0 ? points[selected - 1].density : 0.0f;
+	float highest = selected + 1 < int(points.size()) ? points[selected + 1].density : 1.0f;
+	float density = glm::clamp(value.x, lowest, highest);
+	if (density == point.density && value.y == point.color.a)
+		return false;
+	point.density = density;
+	point.color.a = value.y;
+	return true;
+}
+
+bool TransferFunctionEditor::removeSelected(std::vector<ControlPoint> &points)
+{
+	if (!visible || selected < 0 || selected >= int(points.size()) || points.size() <= 2)
+		return false;
+	points.erase(points.begin() + selected);
+	selected = -1;
+	dragging = false;
+	return true;
+}
+
+bool TransferFunctionEditor::cycleColor(std::vector<ControlPoint> &points)
+{
+	if (!visible || selected < 0 || selected >= int(points.size()))
+		return false;
+	glm::vec3 color = palette[paletteIndex];
+	paletteIndex = (paletteIndex + 1) % paletteSize;
+	points[selected].color = glm::vec4(color, points[selected].color.a);
+	return true;
+}
+
+void TransferFunctionEditor::draw(const TransferFunction &transferFunction, Shader *shader, unsigned int quadVAO, const glm::ivec2 &windowSize)
+{
+	if (!visible)
+		return;
+
+	// The viewport origin is at the bottom left
+	glm::vec4 rect = rectangle(windowSize);
+	glViewport(int(rect.x), windowSize.y - int(rect.y + rect.w), int(rect.z), int(rect.w));
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_CULL_FACE);
+
+	shader->use();
+	shader->setInt("transferFunction", 0);
+	shader->setInt("histogram", 1);
+	shader->setVec2("editorSize", glm::vec2(rect.z, rect.w));
+	shader->setFloat("stripHeight", stripHeight);
+	shader->setInt("selected", selected);
+	int pointCount = std::min(int(transferFunction.points.size()), int(maxPoints));
+	shader->setInt("pointCount", pointCount);
+	for (int i = 0; i < pointCount; i++)
+		shader->setVec2("points[" + std::to_string(i) + "]",
+			glm::vec2(transferFunction.points[i].density, transferFunction.points[i].color.a));
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_1D, transferFunction.textureID);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_1D, histogramTextureID);
+	glActiveTexture(GL_TEXTURE0);
+
+	glBindVertexArray(quadVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+	glBindVertexArray(0);
+
+	glViewport(0, 0, windowSize.x, windowSize.y);
+	glEnable(GL_DEPTH_TEST);
+}
+
+void TransferFunctionEditor::release()
+{
+	glDeleteTextures(1, &histogramTextureID);
+	histogramTextureID = 0;
+}
+
+glm::vec4 TransferFunctionEditor::rectangle(const glm::ivec2 &windowSize) const
+{
+	float width = std::min(512.0f, float(windowSize.x) - 20.0f);
+	float height = std::min(160.0f, float(windowSize.y) / 3.0f);
+	return glm::vec4(10.0f, float(windowSize.y) - 10.0f - height, width, height);
+}
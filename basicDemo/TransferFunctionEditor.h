@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "TransferFunction.h"
+
+class Shader;
+
+// Overlay at the bottom left of the window to edit the transfer function:
+// the control points sit on the opacity curve, over the volume histogram and
+// above a strip with the colors. A left click picks the closest point or
+// inserts one on the curve, dragging moves it between its neighbours
+class TransferFunctionEditor
+{
+public:
+	/**
+	* Creates a hidden editor
+	*/
+	TransferFunctionEditor();
+
+	/**
+	* Loads the histogram shown behind the curve, log scaled so the rare densities stay visible
+	* @param{std::vector<uint64_t> &} voxels per density (256 bins)
+	*/
+	void setHistogram(const std::vector<uint64_t> &bins);
+
+	/**
+	* Handles the left mouse button
+	* @param{glm::vec2 &} cursor position (window pixels, origin at the top left)
+	* @param{bool} the left button is pressed
+	* @param{glm::ivec2 &} window size
+	* @param{std::vector<ControlPoint> &} control points, edited in place
+	* @returns{bool} true if the control points changed
+	*/
+	bool mouse(const glm::vec2 &cursor, bool pressed, const glm::ivec2 &windowSize, std::vector<ControlPoint> &points);
+
+	/**
+	* Removes the selected control point, the function keeps at least two
+	* @param{std::vector<ControlPoint> &} control points, edited in place
+	* @returns{bool} true if the control points changed
+	*/
+	bool removeSelected(std::vector<ControlPoint> &points);
+
+	/**
+	* Gives the selected control point the next color of a fixed palette
+	* @param{std::vector<ControlPoint> &} control points, edited in place
+	* @returns{bool} true if the control points changed
+	*/
+	bool cycleColor(std::vector<ControlPoint> &points);
+
+	/**
+	* Draws the editor over the bound frame buffer
+	* @param{TransferFunction &} transfer function, its texture is already uploaded
+	* @param{Shader *} editor shader
+	* @param{unsigned int} vertex array of a full screen quad (6 vertices)
+	* @param{glm::ivec2 &} window size
+	*/
+	void draw(const TransferFunction &transferFunction, Shader *shader, unsigned int quadVAO, const glm::ivec2 &windowSize);
+
+	/**
+	* Deletes the GPU objects
+	*/
+	void release();
+
+	// Most control points the shader draws
+	static const int maxPoints = 32;
+
+	bool visible;
+	// Index of the selected control point, -1 if none
+	int selected;
+	// Index (GPU) of the histogram texture
+	unsigned int histogramTextureID;
+
+private:
+	/**
+	* Rectangle of the editor in window pixels (origin at the top left)
+	* @returns{glm::vec4} x, y of the top left corner and width, height
+	*/
+	glm::vec4 rectangle(const glm::ivec2 &windowSize) const;
+
+	// The selected point follows the cursor
+	bool dragging;
+	// Index of the next palette color
+	int paletteIndex;
+};
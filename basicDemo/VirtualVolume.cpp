@@ -0,0 +1,251 @@
+#include "VirtualVolume.h"
+#include "BrickSource.h"
+#include "Shader.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+VirtualVolume::VirtualVolume() : source(NULL), slotsPerAxis(0), slotSize(0), residentCount(0), evictionCount(0),
+	frame(0), pageTableDirty(false), atlasTextureID(0), pageTableTextureID(0)
+{
+}
+
+void VirtualVolume::create(BrickSource *source, size_t budget, int prefillLevels)
+{
+	release();
+	this->source = source;
+	slotSize = source->brickSize() + 2;
+
+	// Bricks of every level, the page table stacks the levels along z
+	int levels = std::min(source->levelCount(), maxLevels);
+	levelBricks.clear();
+	levelFirstBrick.clear();
+	levelPageOffset.clear();
+	int bricks = 0;
+	pageTableSize = glm::ivec3(0);
+	for (int level = 0; level < levels; level++)
+	{
+		glm::ivec3 count = source->brickCount(level);
+		levelBricks.push_back(count);
+		levelFirstBrick.push_back(bricks);
+		levelPageOffset.push_back(pageTableSize.z);
+		bricks += count.x * count.y * count.z;
+		pageTableSize = glm::ivec3(glm::max(pageTableSize.x, count.x), glm::max(pageTableSize.y, count.y), pageTableSize.z + count.z);
+	}
+
+	// Largest cubic atlas that fits in the budget and in the driver limits,
+	// slot coordinates are stored in bytes
+	GLint maxSize;
+	glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &maxSize);
+	size_t slotBytes = size_t(slotSize) * slotSize * slotSize;
+	slotsPerAxis = int(std::cbrt(double(budget / slotBytes)));
+	slotsPerAxis = std::max(1, std::min(std::min(slotsPerAxis, int(maxSize) / slotSize), 255));
+	int slots = slotsPerAxis * slotsPerAxis * slotsPerAxis;
+
+	brickSlot.assign(bricks, -1);
+	slotBrick.assign(slots, -1);
+	slotLastUsed.assign(slots, 0);
+	slotPinned.assign(slots, false);
+	freeSlots.clear();
+	for (int slot = slots - 1; slot >= 0; slot--)
+		freeSlots.push_back(slot);
+	residentCount = 0;
+	evictionCount = 0;
+	frame = 0;
+	staging.resize(slotBytes);
+
+	glGenTextures(1, &atlasTextureID);
+	glBindTexture(GL_TEXTURE_3D, atlasTextureID);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	int atlasSize = slotsPerAxis * slotSize;
+	glTexImage3D(GL_TEXTURE_3D, 0, GL_R8, atlasSize, atlasSize, atlasSize, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+
+	glGenTextures(1, &pageTableTextureID);
+	glBindTexture(GL_TEXTURE_3D, pageTableTextureID);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	pageTable.assign(size_t(pageTableSize.x) * pageTableSize.y * pageTableSize.z, glm::u8vec4(0));
+
+	// Coarse levels first, so every point of the volume has some resident data
+	int lastPrefilled = prefillLevels < 0 ? 0 : std::max(levels - prefillLevels, 0);
+	for (int level = levels - 1; level >= lastPrefilled; level--)
+	{
+		glm::ivec3 count = levelBricks[level];
+		for (int z = 0; z < count.z; z++)
+			for (int y = 0; y < count.y; y++)
+				for (int x = 0; x < count.x; x++)
+					if (!freeSlots.empty())
+					{
+						makeResident(level, glm::ivec3(x, y, z));
+						int slot = brickSlot[brickIndex(level, glm::ivec3(x, y, z))];
+						if (slot >= 0 && level == levels - 1)
+							slotPinned[slot] = true;
+					}
+	}
+
+	updatePageTable();
+}
+
+bool VirtualVolume::makeResident(int level, const glm::ivec3 &brick)
+{
+	int index = brickIndex(level, brick);
+	if (brickSlot[index] >= 0)
+		return true;
+	if (!source->readBrick(level, brick, staging.data()))
+		return false;
+	return uploadBrick(index, staging.data());
+}
+
+bool VirtualVolume::uploadBrick(int index, const unsigned char *voxels)
+{
+	if (brickSlot[index] >= 0)
+		return true;
+
+	int slot = -1;
+	if (!freeSlots.empty())
+	{
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		// Least recently used slot, bricks used in this frame are still needed
+		for (int candidate = 0; candidate < int(slotBrick.size()); candidate++)
+			if (!slotPinned[candidate] && slotLastUsed[candidate] < frame &&
+				(slot < 0 || slotLastUsed[candidate] < slotLastUsed[slot]))
+				slot = candidate;
+		if (slot < 0)
+			return false;
+
+		brickSlot[slotBrick[slot]] = -1;
+		residentCount--;
+		evictionCount++;
+	}
+
+	glm::ivec3 slotCoord(slot % slotsPerAxis, (slot / slotsPerAxis) % slotsPerAxis, slot / (slotsPerAxis * slotsPerAxis));
+	glBindTexture(GL_TEXTURE_3D, atlasTextureID);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage3D(GL_TEXTURE_3D, 0, slotCoord.x * slotSize, slotCoord.y * slotSize, slotCoord.z * slotSize,
+		slotSize, slotSize, slotSize, GL_RED, GL_UNSIGNED_BYTE, voxels);
+
+	slotBrick[slot] = index;
+	slotLastUsed[slot] = frame;
+	brickSlot[index] = slot;
+	residentCount++;
+	pageTableDirty = true;
+	return true;
+}
+
+void VirtualVolume::touch(int index)
+{
+	int slot = brickSlot[index];
+	if (slot >= 0)
+		slotLastUsed[slot] = frame;
+}
+
+void VirtualVolume::nextFrame()
+{
+	frame++;
+}
+
+void VirtualVolume::brickCoordinates(int index, int &level, glm::ivec3 &brick) const
+{
+	level = int(std::upper_bound(levelFirstBrick.begin(), levelFirstBrick.end(), index) - levelFirstBrick.begin()) - 1;
+	glm::ivec3 count = levelBricks[level];
+	int local = index - levelFirstBrick[level];
+	brick = glm::ivec3(local % count.x, (local / count.x) % count.y, local / (count.x * count.y));
+}
+
+void VirtualVolume::updatePageTable()
+{
+	int levels = int(levelBricks.size());
+	for (int level = levels - 1; level >= 0; level--)
+	{
+		glm::ivec3 count = levelBricks[level];
+		for (int z = 0; z < count.z; z++)
+			for (int y = 0; y < count.y; y++)
+				for (int x = 0; x < count.x; x++)
+				{
+					glm::ivec3 brick(x, y, z);
+					glm::u8vec4 entry(0);
+					int slot = brickSlot[brickIndex(level, brick)];
+					if (slot >= 0)
+						entry = glm::u8vec4(slot % slotsPerAxis, (slot / slotsPerAxis) % slotsPerAxis,
+							slot / (slotsPerAxis * slotsPerAxis), level + 1);
+					else if (level + 1 < levels)
+					{
+						// The parent entry is already final, levels go from coarse to fine
+						glm::ivec3 parent = glm::min(brick / 2, levelBricks[level + 1] - 1);
+						parent.z += levelPageOffset[level + 1];
+						entry = pageTable[(size_t(parent.z) * pageTableSize.y + parent.y) * pageTableSize.x + parent.x];
+					}
+
+					glm::ivec3 texel(x, y, z + levelPageOffset[level]);
+					pageTable[(size_t(texel.z) * pageTableSize.y + texel.y) * pageTableSize.x + texel.x] = entry;
+				}
+	}
+
+	glBindTexture(GL_TEXTURE_3D, pageTableTextureID);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA8UI, pageTableSize.x, pageTableSize.y, pageTableSize.z, 0,
+		GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, pageTable.data());
+	pageTableDirty = false;
+}
+
+void VirtualVolume::bind(Shader *shader, int pageTableUnit, int atlasUnit) const
+{
+	glActiveTexture(GL_TEXTURE0 + pageTableUnit);
+	glBindTexture(GL_TEXTURE_3D, pageTableTextureID);
+	glActiveTexture(GL_TEXTURE0 + atlasUnit);
+	glBindTexture(GL_TEXTURE_3D, atlasTextureID);
+	glActiveTexture(GL_TEXTURE0);
+
+	shader->setInt("pageTable", pageTableUnit);
+	shader->setInt("brickAtlas", atlasUnit);
+	shader->setFloat("brickSize", float(source->brickSize()));
+	shader->setVec3("atlasSize", glm::vec3(float(slotsPerAxis * slotSize)));
+	shader->setInt("levelCount", int(levelBricks.size()));
+	for (size_t level = 0; level < levelBricks.size(); level++)
+	{
+		std::string index = "[" + std::to_string(level) + "]";
+		shader->setIVec3("levelBricks" + index, levelBricks[level]);
+		shader->setInt("levelPageOffset" + index, levelPageOffset[level]);
+		shader->setInt("levelFirstBrick" + index, levelFirstBrick[level]);
+		shader->setVec3("levelSize" + index, glm::vec3(source->levelDim(int(level))));
+	}
+}
+
+int VirtualVolume::brickIndex(int level, const glm::ivec3 &brick) const
+{
+	glm::ivec3 count = levelBricks[level];
+	return levelFirstBrick[level] + (brick.z * count.y + brick.y) * count.x + brick.x;
+}
+
+void VirtualVolume::release()
+{
+	if (atlasTextureID)
+		glDeleteTextures(1, &atlasTextureID);
+	if (pageTableTextureID)
+		glDeleteTextures(1, &pageTableTextureID);
+	atlasTextureID = 0;
+	pageTableTextureID = 0;
+
+	// The bookkeeping of the bricks goes with the atlas
+	source = NULL;
+	levelBricks.clear();
+	levelFirstBrick.clear();
+	levelPageOffset.clear();
+	brickSlot.clear();
+	slotBrick.clear();
+	slotLastUsed.clear();
+	slotPinned.clear();
+	freeSlots.clear();
+	pageTable.clear();
+	staging.clear();
+	residentCount = 0;
+}
@@ -0,0 +1,137 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+class BrickSource;
+class Shader;
+
+// Software virtual texture of a bricked multi-resolution volume. Resident
+// bricks live in the slots of a 3D atlas texture and a page table texture
+// (one texel per brick, every level stacked along z) maps each brick to its
+// slot. Only needs OpenGL 3.3, no sparse texture extension
+class VirtualVolume
+{
+public:
+	// Highest number of levels the shader supports
+	static const int maxLevels = 12;
+
+	/**
+	* Creates an empty virtual volume
+	*/
+	VirtualVolume();
+
+	/**
+	* Allocates the atlas and the page table and makes bricks resident from
+	* the coarsest level to the finest one until the atlas is full
+	* @param{BrickSource *} source of the bricks
+	* @param{size_t} atlas memory budget in bytes
+	* @param{int} number of coarsest levels loaded up front (-1 for all that fit)
+	*/
+	void create(BrickSource *source, size_t budget, int prefillLevels = -1);
+
+	/**
+	* Reads a brick from the source and loads it into the atlas
+	* @param{int} level
+	* @param{glm::ivec3 &} brick coordinates in the level
+	* @returns{bool} false if there is no slot for it or the brick cannot be read
+	*/
+	bool makeResident(int level, const glm::ivec3 &brick);
+
+	/**
+	* Loads brick data into a free slot, or into the least recently used one if
+	* the atlas is full. The page table has to be updated afterwards
+	* @param{int} brick index
+	* @param{unsigned char *} brick voxels with the apron
+	* @returns{bool} false if every slot is pinned or used in the current frame
+	*/
+	bool uploadBrick(int index, const unsigned char *voxels);
+
+	/**
+	* Marks a resident brick as used in the current frame
+	* @param{int} brick index
+	*/
+	void touch(int index);
+
+	/**
+	* Starts a new frame for the least recently used policy
+	*/
+	void nextFrame();
+
+	/**
+	* Level and coordinates of a brick index
+	* @param{int} brick index
+	* @param{int &} level
+	* @param{glm::ivec3 &} brick coordinates in the level
+	*/
+	void brickCoordinates(int index, int &level, glm::ivec3 &brick) const;
+
+	/**
+	* Computes every page table entry and loads the table into the GPU, a brick
+	* that is not resident points to its closest resident coarser brick
+	*/
+	void updatePageTable();
+
+	/**
+	* Sets the uniforms and binds the textures used by raycast.frag
+	* @param{Shader *} raycast shader
+	* @param{int} texture unit of the page table
+	* @param{int} texture unit of the atlas
+	*/
+	void bind(Shader *shader, int pageTableUnit, int atlasUnit) const;
+
+	/**
+	* Global index of a brick, levels are numbered one after the other
+	* @param{int} level
+	* @param{glm::ivec3 &} brick coordinates in the level
+	* @returns{int} brick index
+	*/
+	int brickIndex(int level, const glm::ivec3 &brick) const;
+
+	/**
+	* Deletes the textures from the GPU and forgets the bricks, create starts over
+	*/
+	void release();
+
+	// Source of the bricks
+	BrickSource *source;
+	// Slots per atlas axis
+	int slotsPerAxis;
+	// Voxels per slot side (brick size plus the apron)
+	int slotSize;
+	// Bricks per axis of every level
+	std::vector<glm::ivec3> levelBricks;
+	// First brick index of every level
+	std::vector<int> levelFirstBrick;
+	// Page table z offset of every level
+	std::vector<int> levelPageOffset;
+	// Slot of every brick (-1 if not resident)
+	std::vector<int> brickSlot;
+	// Brick of every slot (-1 if free)
+	std::vector<int> slotBrick;
+	// Number of resident bricks
+	int residentCount;
+	// Number of bricks evicted to make room for others
+	int evictionCount;
+	// Frame each slot was last used in
+	std::vector<unsigned int> slotLastUsed;
+	// Slots that are never evicted (coarsest level, the fallback of every brick)
+	std::vector<bool> slotPinned;
+	// Current frame
+	unsigned int frame;
+	// The page table does not match the resident bricks
+	bool pageTableDirty;
+	// Index (GPU) of the atlas texture
+	unsigned int atlasTextureID;
+	// Index (GPU) of the page table texture
+	unsigned int pageTableTextureID;
+
+private:
+	// Page table size in texels
+	glm::ivec3 pageTableSize;
+	// Page table entries (xyz = slot, w = resident level + 1, 0 if nothing is resident)
+	std::vector<glm::u8vec4> pageTable;
+	// Staging memory of one brick
+	std::vector<unsigned char> staging;
+	// Slots that hold no brick
+	std::vector<int> freeSlots;
+};
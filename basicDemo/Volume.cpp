@@ -0,0 +1,149 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "Volume.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cstdio>
+
+Volume::Volume() : dim(0), spacing(1.0f)
+{
+}
+
+bool Volume::loadRaw(const char *path, const glm::ivec3 &dimensions)
+{
+	FILE *pFile = fopen(path, "rb");
+	if (NULL == pFile)
+		return false;
+
+	dim = dimensions;
+	data.resize(voxelCount());
+	size_t read = fread(data.data(), sizeof(unsigned char), data.size(), pFile);
+	fclose(pFile);
+
+	if (read != data.size())
+	{
+		dim = glm::ivec3(0);
+		data.clear();
+		return false;
+	}
+	return true;
+}
+
+namespace
+{
+	template <typename T>
+	bool readVoxels(const char *path, const glm::ivec3 &dimensions, std::vector<T> &voxels)
+	{
+		FILE *pFile = fopen(path, "rb");
+		if (NULL == pFile)
+			return false;
+
+		voxels.resize(size_t(dimensions.x) * dimensions.y * dimensions.z);
+		size_t read = fread(voxels.data(), sizeof(T), voxels.size(), pFile);
+		fclose(pFile);
+		if (read != voxels.size())
+		{
+			voxels.clear();
+			return false;
+		}
+		return true;
+	}
+
+	template <typename T>
+	void quantizeVoxels(const T *voxels, const glm::ivec3 &dimensions, double low, double high, std::vector<unsigned char> &data)
+	{
+		data.resize(size_t(dimensions.x) * dimensions.y * dimensions.z);
+		size_t slice = size_t(dimensions.x) * dimensions.y;
+		float offset = float(low);
+		float scale = high > low ? float(255.0 / (high - low)) : 0.0f;
+		parallelFor(0, dimensions.z, [&](int first, int last) {
+			for (size_t i = first * slice; i < last * slice; i++)
+			{
+				float v = (float(voxels[i]) - offset) * scale + 0.5f;
+				// The comparisons are false for NaNs, they end up at 0
+				data[i] = v >= 255.0f ? 255 : v > 0.0f ? (unsigned char)v : 0;
+			}
+		});
+	}
+}
+
+bool Volume::readRaw(const char *path, const glm::ivec3 &dimensions, std::vector<unsigned short> &voxels)
+{
+	return readVoxels(path, dimensions, voxels);
+}
+
+bool Volume::readRaw(const char *path, const glm::ivec3 &dimensions, std::vector<float> &voxels)
+{
+	return readVoxels(path, dimensions, voxels);
+}
+
+void Volume::quantize(const unsigned short *voxels, const glm::ivec3 &dimensions, double low, double high)
+{
+	dim = dimensions;
+	quantizeVoxels(voxels, dimensions, low, high, data);
+}
+
+void Volume::quantize(const float *voxels, const glm::ivec3 &dimensions, double low, double high)
+{
+	dim = dimensions;
+	quantizeVoxels(voxels, dimensions, low, high, data);
+}
+
+unsigned char Volume::voxel(int x, int y, int z) const
+{
+	x = std::min(std::max(x, 0), dim.x - 1);
+	y = std::min(std::max(y, 0), dim.y - 1);
+	z = std::min(std::max(z, 0), dim.z - 1);
+	return data[(size_t(z) * dim.y + y) * dim.x + x];
+}
+
+size_t Volume::voxelCount() const
+{
+	return size_t(dim.x) * dim.y * dim.z;
+}
+
+glm::vec3 Volume::extent() const
+{
+	glm::vec3 size = glm::vec3(glm::max(dim, glm::ivec3(1))) * spacing;
+	return size / std::max(std::max(size.x, size.y), size.z);
+}
+
+Volume Volume::downsample(const glm::ivec3 &coarseDim) const
+{
+	Volume coarse;
+	coarse.dim = coarseDim;
+	coarse.data.resize(coarse.voxelCount());
+
+	std::vector<std::vector<FilterTap> > tapsX = boxFilterTaps(dim.x, coarseDim.x);
+	std::vector<std::vector<FilterTap> > tapsY = boxFilterTaps(dim.y, coarseDim.y);
+	std::vector<std::vector<FilterTap> > tapsZ = boxFilterTaps(dim.z, coarseDim.z);
+	auto fetch = [this](int x, int y, int z) { return data[(size_t(z) * dim.y + y) * dim.x + x]; };
+
+	parallelFor(0, coarseDim.z, [&](int first, int last) {
+		for (int z = first; z < last; z++)
+		{
+			unsigned char *out = &coarse.data[size_t(z) * coarseDim.y * coarseDim.x];
+			for (int y = 0; y < coarseDim.y; y++)
+				for (int x = 0; x < coarseDim.x; x++)
+					*out++ = boxFilter(tapsX[x], tapsY[y], tapsZ[z], fetch);
+		}
+	});
+	return coarse;
+}
+
+std::vector<std::vector<FilterTap> > boxFilterTaps(int fineSize, int coarseSize)
+{
+	// In units of 1 / coarseSize fine voxels, so the bounds are integers
+	std::vector<std::vector<FilterTap> > taps(coarseSize);
+	for (int i = 0; i < coarseSize; i++)
+	{
+		int begin = i * fineSize, end = (i + 1) * fineSize;
+		for (int f = begin / coarseSize; f * coarseSize < end; f++)
+		{
+			int covered = std::min(end, (f + 1) * coarseSize) - std::max(begin, f * coarseSize);
+			FilterTap tap = { f, float(covered) / float(fineSize) };
+			taps[i].push_back(tap);
+		}
+	}
+	return taps;
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Contribution of a fine voxel to a coarse voxel along one axis
+struct FilterTap
+{
+	// Fine voxel coordinate
+	int index;
+	// Fraction of the coarse voxel the fine voxel covers
+	float weight;
+};
+
+/**
+* Box filter footprint of every coarse voxel along one axis. Coarse voxel i
+* covers the fine interval [i, i + 1) * fineSize / coarseSize, so halving
+* even sizes averages pairs and odd sizes (either rounding) get fractional
+* weights instead of a dropped or repeated border voxel
+* @param{int} fine voxels along the axis
+* @param{int} coarse voxels along the axis
+* @returns{std::vector<std::vector<FilterTap> >} taps of every coarse voxel
+*/
+std::vector<std::vector<FilterTap> > boxFilterTaps(int fineSize, int coarseSize);
+
+/**
+* Box filters one coarse voxel
+* @param{std::vector<FilterTap> &} x taps of the voxel
+* @param{std::vector<FilterTap> &} y taps of the voxel
+* @param{std::vector<FilterTap> &} z taps of the voxel
+* @param{Fetch} callable as fetch(int x, int y, int z), returns a fine voxel
+* @returns{unsigned char} filtered value
+*/
+template <typename Fetch>
+unsigned char boxFilter(const std::vector<FilterTap> &tx, const std::vector<FilterTap> &ty, const std::vector<FilterTap> &tz, Fetch fetch)
+{
+	float sum = 0.0f;
+	for (const FilterTap &z : tz)
+		for (const FilterTap &y : ty)
+		{
+			float weight = z.weight * y.weight;
+			for (const FilterTap &x : tx)
+				sum += weight * x.weight * fetch(x.index, y.index, z.index);
+		}
+	return (unsigned char)std::min(sum + 0.5f, 255.0f);
+}
+
+// Scalar volume kept in main memory, one unsigned byte per voxel
+// stored x-fastest, then y, then z
+class Volume
+{
+public:
+	/**
+	* Creates an empty volume
+	*/
+	Volume();
+
+	/**
+	* Loads a raw unsigned byte volume
+	* @param{const char*} Path to the raw file
+	* @param{glm::ivec3 &} Voxels per axis
+	* @returns{bool} true if the whole volume could be read
+	*/
+	bool loadRaw(const char* path, const glm::ivec3 &dimensions);
+
+	/**
+	* Reads a raw volume of unsigned shorts or floats as it is stored
+	* @param{const char*} Path to the raw file
+	* @param{glm::ivec3 &} Voxels per axis
+	* @param{std::vector<T> &} voxels read, x fastest
+	* @returns{bool} true if the whole volume could be read
+	*/
+	static bool readRaw(const char* path, const glm::ivec3 &dimensions, std::vector<unsigned short> &voxels);
+	static bool readRaw(const char* path, const glm::ivec3 &dimensions, std::vector<float> &voxels);
+
+	/**
+	* Keeps wider voxels as bytes, [low, high] is mapped linearly to [0, 255]
+	* and the values outside it (and NaNs, to 0) are clamped; the slices are
+	* converted in parallel
+	* @param{const T*} voxels, x fastest
+	* @param{glm::ivec3 &} Voxels per axis
+	* @param{double} value mapped to 0
+	* @param{double} value mapped to 255
+	*/
+	void quantize(const unsigned short *voxels, const glm::ivec3 &dimensions, double low, double high);
+	void quantize(const float *voxels, const glm::ivec3 &dimensions, double low, double high);
+
+	/**
+	* Gets a voxel value, coordinates outside the volume are clamped to the border
+	* @param{int} x coordinate
+	* @param{int} y coordinate
+	* @param{int} z coordinate
+	* @returns{unsigned char} voxel value
+	*/
+	unsigned char voxel(int x, int y, int z) const;
+
+	/**
+	* Number of voxels of the volume
+	* @returns{size_t} voxel count
+	*/
+	size_t voxelCount() const;
+
+	/**
+	* Size of the volume box with its largest side scaled to 1, the voxels
+	* keep their spacing instead of being resampled
+	* @returns{glm::vec3} box size per axis
+	*/
+	glm::vec3 extent() const;
+
+	/**
+	* Box filters the volume to a lower resolution, the slices are
+	* filtered in parallel
+	* @param{glm::ivec3 &} voxels per axis of the result, at most dim
+	* @returns{Volume} filtered volume
+	*/
+	Volume downsample(const glm::ivec3 &coarseDim) const;
+
+	// Version of the downsampling filter, part of the derived data cache key
+	static const int downsampleVersion = 1;
+
+	// Voxels per axis
+	glm::ivec3 dim;
+	// Distance between voxel centers along each axis (only the ratios matter)
+	glm::vec3 spacing;
+	// Voxel values
+	std::vector<unsigned char> data;
+};
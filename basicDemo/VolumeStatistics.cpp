@@ -0,0 +1,507 @@
+#include "VolumeStatistics.h"
+#include "Volume.h"
+#include "Shader.h"
+#include "Parallel.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <mutex>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STATISTICS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Totals of a group of rows
+	struct Partial
+	{
+		explicit Partial(int binCount) : bins(binCount, 0), count(0),
+			minimum(std::numeric_limits<double>::infinity()), maximum(-std::numeric_limits<double>::infinity()),
+			sum(0.0), sumSquares(0.0)
+		{
+		}
+
+		void merge(const Partial &other)
+		{
+			for (size_t i = 0; i < bins.size(); i++)
+				bins[i] += other.bins[i];
+			count += other.count;
+			minimum = std::min(minimum, other.minimum);
+			maximum = std::max(maximum, other.maximum);
+			sum += other.sum;
+			sumSquares += other.sumSquares;
+		}
+
+		std::vector<uint64_t> bins;
+		uint64_t count;
+		double minimum;
+		double maximum;
+		double sum;
+		double sumSquares;
+	};
+
+	// Consecutive voxels are counted on different sub-histograms, runs of equal
+	// values (empty space) would otherwise wait on the increment of each other
+	const int subHistograms = 4;
+	// Voxels counted before the 32 bit sub-histograms are added to the totals
+	const uint64_t flushInterval = uint64_t(1) << 31;
+
+	// Private bins of a thread
+	class Bins
+	{
+	public:
+		explicit Bins(int binCount) : counts(size_t(subHistograms) * binCount, 0), binCount(binCount), pending(0)
+		{
+		}
+
+		uint32_t *sub(int index)
+		{
+			return counts.data() + size_t(index) * binCount;
+		}
+
+		void added(int voxels, Partial &partial)
+		{
+			pending += voxels;
+			if (pending >= flushInterval)
+				flush(partial);
+		}
+
+		void flush(Partial &partial)
+		{
+			for (int i = 0; i < binCount; i++)
+				for (int s = 0; s < subHistograms; s++)
+					partial.bins[i] += counts[size_t(s) * binCount + i];
+			std::fill(counts.begin(), counts.end(), 0);
+			pending = 0;
+		}
+
+	private:
+		std::vector<uint32_t> counts;
+		int binCount;
+		uint64_t pending;
+	};
+
+	/**
+	* Counts a row of integer voxels
+	* @param{BinOf} callable as binOf(T value), returns the bin of a voxel
+	*/
+	template <typename T, typename BinOf>
+	void countRow(const T *row, int length, Bins &bins, BinOf binOf)
+	{
+		uint32_t *h0 = bins.sub(0), *h1 = bins.sub(1), *h2 = bins.sub(2), *h3 = bins.sub(3);
+		int i = 0;
+		for (; i + 4 <= length; i += 4)
+		{
+			h0[binOf(row[i])]++;
+			h1[binOf(row[i + 1])]++;
+			h2[binOf(row[i + 2])]++;
+			h3[binOf(row[i + 3])]++;
+		}
+		for (; i < length; i++)
+			h0[binOf(row[i])]++;
+	}
+
+	void byteRow(const unsigned char *row, int length, Bins &bins, Partial &partial)
+	{
+		countRow(row, length, bins, [](unsigned char v) { return v; });
+
+		int lo = 255, hi = 0;
+		uint64_t sum = 0, squares = 0;
+		int i = 0;
+#ifdef STATISTICS_SSE2
+		if (length >= 16)
+		{
+			const __m128i zero = _mm_setzero_si128();
+			__m128i vlo = _mm_set1_epi8(char(0xff)), vhi = zero, vsum = zero;
+			while (i + 16 <= length)
+			{
+				// The 32 bit lanes of the squares hold 8256 blocks of 16 voxels
+				int blockEnd = std::min(length, i + 4096 * 16);
+				__m128i vsquares = zero;
+				for (; i + 16 <= blockEnd; i += 16)
+				{
+					__m128i v = _mm_loadu_si128((const __m128i *)(row + i));
+					vlo = _mm_min_epu8(vlo, v);
+					vhi = _mm_max_epu8(vhi, v);
+					vsum = _mm_add_epi64(vsum, _mm_sad_epu8(v, zero));
+					__m128i low = _mm_unpacklo_epi8(v, zero), high = _mm_unpackhi_epi8(v, zero);
+					vsquares = _mm_add_epi32(vsquares, _mm_add_epi32(_mm_madd_epi16(low, low), _mm_madd_epi16(high, high)));
+				}
+				uint32_t lanes[4];
+				_mm_storeu_si128((__m128i *)lanes, vsquares);
+				squares += uint64_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+			}
+			uint64_t sums[2];
+			unsigned char los[16], his[16];
+			_mm_storeu_si128((__m128i *)sums, vsum);
+			_mm_storeu_si128((__m128i *)los, vlo);
+			_mm_storeu_si128((__m128i *)his, vhi);
+			sum = sums[0] + sums[1];
+			lo = *std::min_element(los, los + 16);
+			hi = *std::max_element(his, his + 16);
+		}
+#endif
+		for (; i < length; i++)
+		{
+			int v = row[i];
+			lo = std::min(lo, v);
+			hi = std::max(hi, v);
+			sum += v;
+			squares += uint64_t(v * v);
+		}
+
+		partial.count += length;
+		partial.minimum = std::min(partial.minimum, double(lo));
+		partial.maximum = std::max(partial.maximum, double(hi));
+		partial.sum += double(sum);
+		partial.sumSquares += double(squares);
+		bins.added(length, partial);
+	}
+
+	void shortRow(const unsigned short *row, int length, int shift, Bins &bins, Partial &partial)
+	{
+		countRow(row, length, bins, [shift](unsigned short v) { return v >> shift; });
+
+		int lo = 65535, hi = 0;
+		int i = 0;
+#ifdef STATISTICS_SSE2
+		if (length >= 8)
+		{
+			// SSE2 only compares signed words, the sign bit is flipped so the order is kept
+			const __m128i bias = _mm_set1_epi16(short(0x8000));
+			__m128i vlo = _mm_set1_epi16(0x7fff), vhi = _mm_set1_epi16(short(0x8000));
+			for (; i + 8 <= length; i += 8)
+			{
+				__m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(row + i)), bias);
+				vlo = _mm_min_epi16(vlo, v);
+				vhi = _mm_max_epi16(vhi, v);
+			}
+			unsigned short los[8], his[8];
+			_mm_storeu_si128((__m128i *)los, _mm_xor_si128(vlo, bias));
+			_mm_storeu_si128((__m128i *)his, _mm_xor_si128(vhi, bias));
+			lo = *std::min_element(los, los + 8);
+			hi = *std::max_element(his, his + 8);
+		}
+#endif
+		for (; i < length; i++)
+		{
+			lo = std::min(lo, int(row[i]));
+			hi = std::max(hi, int(row[i]));
+		}
+
+		// Squares of 16 bit values need 64 bit sums, SSE2 has no unsigned word multiply-add
+		uint64_t sum = 0, squares = 0;
+		for (i = 0; i < length; i++)
+		{
+			uint64_t v = row[i];
+			sum += v;
+			squares += v * v;
+		}
+
+		partial.count += length;
+		partial.minimum = std::min(partial.minimum, double(lo));
+		partial.maximum = std::max(partial.maximum, double(hi));
+		partial.sum += double(sum);
+		partial.sumSquares += double(squares);
+		bins.added(length, partial);
+	}
+
+	// Range of a row of floats, NaNs are skipped
+	void floatRange(const float *row, int length, Partial &partial)
+	{
+		float lo = std::numeric_limits<float>::infinity(), hi = -lo;
+		int i = 0;
+#ifdef STATISTICS_SSE2
+		if (length >= 4)
+		{
+			// minps and maxps return their second operand if either one is a NaN
+			__m128 vlo = _mm_set1_ps(lo), vhi = _mm_set1_ps(hi);
+			for (; i + 4 <= length; i += 4)
+			{
+				__m128 v = _mm_loadu_ps(row + i);
+				vlo = _mm_min_ps(v, vlo);
+				vhi = _mm_max_ps(v, vhi);
+			}
+			float los[4], his[4];
+			_mm_storeu_ps(los, vlo);
+			_mm_storeu_ps(his, vhi);
+			lo = *std::min_element(los, los + 4);
+			hi = *std::max_element(his, his + 4);
+		}
+#endif
+		for (; i < length; i++)
+			if (row[i] == row[i])
+			{
+				lo = std::min(lo, row[i]);
+				hi = std::max(hi, row[i]);
+			}
+		partial.minimum = std::min(partial.minimum, double(lo));
+		partial.maximum = std::max(partial.maximum, double(hi));
+	}
+
+	// Values outside the bins are counted on the first or last one
+	void floatRow(const float *row, int length, float start, float scale, int binCount, Bins &bins, Partial &partial)
+	{
+		floatRange(row, length, partial);
+
+		uint32_t *h[subHistograms] = { bins.sub(0), bins.sub(1), bins.sub(2), bins.sub(3) };
+		double sum = 0.0, squares = 0.0;
+		int counted = 0;
+		for (int i = 0; i < length; i++)
+		{
+			float v = row[i];
+			if (v != v)
+				continue;
+			int bin = std::min(std::max(int((v - start) * scale), 0), binCount - 1);
+			h[i & (subHistograms - 1)][bin]++;
+			sum += v;
+			squares += double(v) * v;
+			counted++;
+		}
+
+		partial.count += counted;
+		partial.sum += sum;
+		partial.sumSquares += squares;
+		bins.added(length, partial);
+	}
+
+	VoxelBox clampRegion(const glm::ivec3 &dim, const VoxelBox *region)
+	{
+		VoxelBox box = { glm::ivec3(0), dim - 1 };
+		if (region)
+		{
+			box.first = glm::max(region->first, box.first);
+			box.last = glm::min(region->last, box.last);
+		}
+		return box;
+	}
+
+	/**
+	* Splits the rows of a box among the threads, every one with its own bins
+	* @param{Row} callable as row(const T *voxels, int length, Bins &, Partial &)
+	*/
+	template <typename T, typename Row>
+	Partial accumulate(const T *data, const glm::ivec3 &dim, const VoxelBox &box, int binCount, Row row)
+	{
+		Partial total(binCount);
+		glm::ivec3 size = box.last - box.first + 1;
+		if (glm::any(glm::lessThan(size, glm::ivec3(1))))
+			return total;
+
+		std::mutex mutex;
+		parallelFor(0, size.y * size.z, [&](int firstRow, int lastRow)
+		{
+			Partial partial(binCount);
+			Bins bins(binCount);
+			for (int r = firstRow; r < lastRow; r++)
+			{
+				size_t y = size_t(box.first.y + r % size.y), z = size_t(box.first.z + r / size.y);
+				row(data + (z * dim.y + y) * dim.x + box.first.x, size.x, bins, partial);
+			}
+			bins.flush(partial);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			total.merge(partial);
+		});
+		return total;
+	}
+
+	StatisticsSummary summarize(const Partial &total)
+	{
+		StatisticsSummary summary = { total.count, 0.0, 0.0, 0.0, 0.0 };
+		if (!total.count)
+			return summary;
+		summary.minimum = total.minimum;
+		summary.maximum = total.maximum;
+		summary.mean = total.sum / double(total.count);
+		double variance = total.sumSquares / double(total.count) - summary.mean * summary.mean;
+		summary.standardDeviation = std::sqrt(std::max(variance, 0.0));
+		return summary;
+	}
+}
+
+VolumeStatistics::VolumeStatistics() : binStart(0.0), binWidth(1.0)
+{
+	summary = StatisticsSummary{ 0, 0.0, 0.0, 0.0, 0.0 };
+}
+
+void VolumeStatistics::compute(const Volume &volume, const VoxelBox *region)
+{
+	Partial total = accumulate(volume.data.data(), volume.dim, clampRegion(volume.dim, region), 256, byteRow);
+	summary = summarize(total);
+	bins.swap(total.bins);
+	// Integer values sit at the center of their bins
+	binStart = -0.5;
+	binWidth = 1.0;
+}
+
+void VolumeStatistics::compute(const unsigned short *data, const glm::ivec3 &dim, int binCount, const VoxelBox *region)
+{
+	int shift = 0;
+	while (shift < 16 && (65536 >> shift) > binCount)
+		shift++;
+
+	Partial total = accumulate(data, dim, clampRegion(dim, region), 65536 >> shift,
+		[shift](const unsigned short *row, int length, Bins &counts, Partial &partial) { shortRow(row, length, shift, counts, partial); });
+	summary = summarize(total);
+	bins.swap(total.bins);
+	binStart = -0.5;
+	binWidth = double(1 << shift);
+}
+
+void VolumeStatistics::compute(const float *data, const glm::ivec3 &dim, int binCount, const VoxelBox *region, const glm::vec2 *range)
+{
+	VoxelBox box = clampRegion(dim, region);
+	binCount = std::max(binCount, 1);
+
+	glm::vec2 bounds;
+	if (range)
+		bounds = *range;
+	else
+	{
+		Partial extent = accumulate(data, dim, box, 0,
+			[](const float *row, int length, Bins &, Partial &partial) { floatRange(row, length, partial); });
+		bounds = extent.minimum <= extent.maximum ? glm::vec2(extent.minimum, extent.maximum) : glm::vec2(0.0f);
+	}
+	float width = bounds.y > bounds.x ? (bounds.y - bounds.x) / binCount : 1.0f;
+	float scale = 1.0f / width;
+
+	Partial total = accumulate(data, dim, box, binCount,
+		[&](const float *row, int length, Bins &counts, Partial &partial) { floatRow(row, length, bounds.x, scale, binCount, counts, partial); });
+	summary = summarize(total);
+	bins.swap(total.bins);
+	binStart = bounds.x;
+	binWidth = width;
+}
+
+bool VolumeStatistics::computeOnGPU(unsigned int volumeTexture, const glm::ivec3 &dim, Shader *shader, const VoxelBox *region)
+{
+	const int binCount = 256;
+	VoxelBox box = clampRegion(dim, region);
+	glm::ivec3 size = glm::max(box.last - box.first + 1, glm::ivec3(0));
+
+	unsigned int target, fbo;
+	glGenTextures(1, &target);
+	glBindTexture(GL_TEXTURE_2D, target);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, binCount, 1, 0, GL_RED, GL_FLOAT, NULL);
+
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "ERROR::STATISTICS The histogram target is not renderable, use the CPU path" << std::endl;
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(1, &fbo);
+		glDeleteTextures(1, &target);
+		return false;
+	}
+
+	GLint viewport[4], blendSource, blendDestination;
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetIntegerv(GL_BLEND_SRC_RGB, &blendSource);
+	glGetIntegerv(GL_BLEND_DST_RGB, &blendDestination);
+	GLboolean blend = glIsEnabled(GL_BLEND);
+	glViewport(0, 0, binCount, 1);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_CULL_FACE);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE);
+
+	shader->use();
+	shader->setInt("volume", 0);
+	shader->setIVec3("regionFirst", box.first);
+	shader->setIVec3("regionSize", size);
+	shader->setInt("binCount", binCount);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_3D, volumeTexture);
+
+	// The points take everything from the vertex index, the vertex array has no attributes
+	unsigned int vao;
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
+	// Float counts are exact up to 2^24, no bin of a batch can go over it
+	int rows = size.y * size.z;
+	int batchRows = std::max(1, (1 << 24) / std::max(size.x, 1));
+	const float zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	std::vector<float> counts(binCount);
+	bins.assign(binCount, 0);
+	for (int firstRow = 0; firstRow < rows && size.x > 0; firstRow += batchRows)
+	{
+		int batch = std::min(batchRows, rows - firstRow);
+		glClearBufferfv(GL_COLOR, 0, zero);
+		shader->setInt("firstRow", firstRow);
+		glDrawArrays(GL_POINTS, 0, batch * size.x);
+		glReadPixels(0, 0, binCount, 1, GL_RED, GL_FLOAT, counts.data());
+		for (int i = 0; i < binCount; i++)
+			bins[i] += uint64_t(counts[i]);
+	}
+
+	glBindVertexArray(0);
+	glDeleteVertexArrays(1, &vao);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteTextures(1, &target);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glBlendFunc(blendSource, blendDestination);
+	if (!blend)
+		glDisable(GL_BLEND);
+	glEnable(GL_DEPTH_TEST);
+
+	// Every bin is a single value, the moments follow from the counts
+	Partial total(0);
+	for (int i = 0; i < binCount; i++)
+		if (bins[i])
+		{
+			total.count += bins[i];
+			total.minimum = std::min(total.minimum, double(i));
+			total.maximum = double(i);
+			total.sum += double(i) * bins[i];
+			total.sumSquares += double(i) * i * bins[i];
+		}
+	summary = summarize(total);
+	binStart = -0.5;
+	binWidth = 1.0;
+	return true;
+}
+
+bool VolumeStatistics::assign(const unsigned char *data, size_t size)
+{
+	if (size != sizeof(StatisticsSummary) + 256 * sizeof(uint64_t))
+		return false;
+	memcpy(&summary, data, sizeof(StatisticsSummary));
+	bins.resize(256);
+	memcpy(bins.data(), data + sizeof(StatisticsSummary), 256 * sizeof(uint64_t));
+	binStart = -0.5;
+	binWidth = 1.0;
+	return true;
+}
+
+double VolumeStatistics::percentile(float fraction) const
+{
+	if (!summary.count)
+		return 0.0;
+
+	double target = double(std::min(std::max(fraction, 0.0f), 1.0f)) * double(summary.count);
+	double below = 0.0;
+	double value = summary.maximum;
+	for (size_t i = 0; i < bins.size(); i++)
+	{
+		if (bins[i] && below + double(bins[i]) >= target)
+		{
+			value = binStart + (double(i) + (target - below) / double(bins[i])) * binWidth;
+			break;
+		}
+		below += double(bins[i]);
+	}
+	// The bins are wider than the data at the ends
+	return std::min(std::max(value, summary.minimum), summary.maximum);
+}
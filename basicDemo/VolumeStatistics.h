@@ -0,0 +1,102 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+class Volume;
+class Shader;
+
+// Region of interest of a volume, first and last voxel included
+struct VoxelBox
+{
+	glm::ivec3 first;
+	glm::ivec3 last;
+};
+
+// Moments of the voxel values, in the units of the data
+struct StatisticsSummary
+{
+	// Voxels counted (NaNs are skipped)
+	uint64_t count;
+	double minimum;
+	double maximum;
+	double mean;
+	double standardDeviation;
+};
+
+// Histogram, range, mean and percentiles of a volume or of a box of it.
+// The CPU paths split the rows among the threads, each one with private bins
+// merged at the end, so no atomics are needed. The GPU path scatters one
+// point per voxel of the resident 3D texture into the bins
+class VolumeStatistics
+{
+public:
+	/**
+	* Creates empty statistics
+	*/
+	VolumeStatistics();
+
+	/**
+	* Statistics of an unsigned byte volume, one bin per value
+	* @param{Volume &} volume
+	* @param{VoxelBox *} region of interest, NULL for the whole volume
+	*/
+	void compute(const Volume &volume, const VoxelBox *region = NULL);
+
+	/**
+	* Statistics of an unsigned short volume, the bins split [0, 65536) evenly
+	* @param{const unsigned short*} voxels, x fastest
+	* @param{glm::ivec3 &} voxels per axis
+	* @param{int} number of bins, a power of two up to 65536
+	* @param{VoxelBox *} region of interest, NULL for the whole volume
+	*/
+	void compute(const unsigned short *data, const glm::ivec3 &dim, int binCount, const VoxelBox *region = NULL);
+
+	/**
+	* Statistics of a float volume, the bins split the value range evenly
+	* @param{const float*} voxels, x fastest
+	* @param{glm::ivec3 &} voxels per axis
+	* @param{int} number of bins
+	* @param{VoxelBox *} region of interest, NULL for the whole volume
+	* @param{glm::vec2 *} range of the bins, NULL for the minimum and maximum of the data (one more pass)
+	*/
+	void compute(const float *data, const glm::ivec3 &dim, int binCount, const VoxelBox *region = NULL, const glm::vec2 *range = NULL);
+
+	/**
+	* Statistics of the unsigned byte volume already in a 3D texture. Every
+	* voxel is drawn as a point on its bin of a 256x1 float target with
+	* additive blending, in batches small enough to keep the counts exact
+	* @param{unsigned int} GPU index of the volume 3D texture
+	* @param{glm::ivec3 &} voxels per axis
+	* @param{Shader *} histogram shader
+	* @param{VoxelBox *} region of interest, NULL for the whole volume
+	* @returns{bool} false if the driver cannot render into the bins
+	*/
+	bool computeOnGPU(unsigned int volumeTexture, const glm::ivec3 &dim, Shader *shader, const VoxelBox *region = NULL);
+
+	/**
+	* Restores unsigned byte statistics stored as the summary followed by the 256 bins
+	* @param{const unsigned char*} stored statistics
+	* @param{size_t} bytes of the stored statistics
+	* @returns{bool} false if the size does not match
+	*/
+	bool assign(const unsigned char *data, size_t size);
+
+	/**
+	* Value below which a fraction of the voxels falls, interpolated inside its bin
+	* @param{float} fraction of the voxels [0, 1]
+	* @returns{double} value in the units of the data
+	*/
+	double percentile(float fraction) const;
+
+	// Version of the statistics stored in the derived data cache
+	static const int version = 1;
+
+	StatisticsSummary summary;
+	// Voxels per bin
+	std::vector<uint64_t> bins;
+	// Lower value and width of the first bin
+	double binStart;
+	double binWidth;
+};
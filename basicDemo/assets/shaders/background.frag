@@ -0,0 +1,14 @@
+#version 330 core
+// Vertex color (interpolated/fragment)
+in vec3 vColor;
+in vec3 vPos;
+
+uniform vec3 backgroundColor;
+
+// Fragment Color
+out vec4 color;
+
+void main()
+{
+	color = vec4(backgroundColor, 1.0f);
+}
\ No newline at end of file
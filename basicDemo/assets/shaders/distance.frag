@@ -0,0 +1,41 @@
+#version 330 core
+// One axis of the Chebyshev distance transform of the occupancy, see DistanceGrid
+
+// Uniforms
+// Occupancy bitfield, read by the x pass
+uniform usampler3D occupancy;
+// Distances of the previous axis, read by the y and z passes
+uniform usampler3D source;
+uniform ivec3 cellCount;
+uniform int slice;
+uniform int axis;
+uniform int maxDistance;
+
+out uint distance;
+
+uint previous(ivec3 cell)
+{
+	if (axis == 0)
+		return (texelFetch(occupancy, ivec3(cell.x >> 3, cell.yz), 0).r & (1u << uint(cell.x & 7))) != 0u ? 0u : uint(maxDistance);
+	return texelFetch(source, cell, 0).r;
+}
+
+void main()
+{
+	ivec3 cell = ivec3(ivec2(gl_FragCoord.xy), slice);
+	ivec3 offset = ivec3(equal(ivec3(axis), ivec3(0, 1, 2)));
+	int position = cell[axis];
+	int size = cellCount[axis];
+
+	// Cells farther than the best distance so far cannot improve it
+	uint best = previous(cell);
+	for (int o = 1; uint(o) < best; o++) {
+		if (position - o < 0 && position + o >= size)
+			break;
+		if (position - o >= 0)
+			best = min(best, max(uint(o), previous(cell - offset * o)));
+		if (position + o < size)
+			best = min(best, max(uint(o), previous(cell + offset * o)));
+	}
+	distance = best;
+}
@@ -0,0 +1,34 @@
+#version 330 core
+// Computes one slice of the gradient volume, same encoding as GradientVolume::build
+
+// Uniforms
+uniform sampler3D volume;
+uniform ivec3 volumeSize;
+uniform int slice;
+uniform float maxMagnitude;
+
+// Octahedral encoded direction and sqrt companded magnitude
+layout (location = 0) out vec2 normal;
+layout (location = 1) out float magnitude;
+
+float voxel(ivec3 p)
+{
+	return texelFetch(volume, clamp(p, ivec3(0), volumeSize - 1), 0).r;
+}
+
+void main()
+{
+	ivec3 p = ivec3(ivec2(gl_FragCoord.xy), slice);
+	vec3 g = 0.5f * vec3(
+		voxel(p + ivec3(1, 0, 0)) - voxel(p - ivec3(1, 0, 0)),
+		voxel(p + ivec3(0, 1, 0)) - voxel(p - ivec3(0, 1, 0)),
+		voxel(p + ivec3(0, 0, 1)) - voxel(p - ivec3(0, 0, 1)));
+
+	float l1 = abs(g.x) + abs(g.y) + abs(g.z);
+	vec2 e = l1 > 0.0f ? g.xy / l1 : vec2(0.0f);
+	if (g.z < 0.0f)
+		e = (1.0f - abs(e.yx)) * vec2(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+
+	normal = e;
+	magnitude = sqrt(min(length(g) / maxMagnitude, 1.0f));
+}
@@ -0,0 +1,9 @@
+#version 330 core
+// One voxel more on the bin, the target adds the points with blending
+
+out float count;
+
+void main()
+{
+	count = 1.0f;
+}
@@ -0,0 +1,18 @@
+#version 330 core
+// Draws every voxel of a region as a point on its bin, see VolumeStatistics::computeOnGPU
+
+// Uniforms
+uniform sampler3D volume;
+uniform ivec3 regionFirst;
+uniform ivec3 regionSize;
+uniform int firstRow;
+uniform int binCount;
+
+void main()
+{
+	int row = firstRow + gl_VertexID / regionSize.x;
+	ivec3 voxel = regionFirst + ivec3(gl_VertexID % regionSize.x, row % regionSize.y, row / regionSize.y);
+	// Unsigned byte texels are read as value / 255
+	int bin = int(texelFetch(volume, voxel, 0).r * float(binCount - 1) + 0.5f);
+	gl_Position = vec4((float(bin) + 0.5f) / float(binCount) * 2.0f - 1.0f, 0.0f, 0.0f, 1.0f);
+}
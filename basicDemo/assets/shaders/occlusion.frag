@@ -0,0 +1,19 @@
+#version 330 core
+// Farthest occluder depth of every blockSize x blockSize block of the window
+
+// Uniforms
+uniform sampler2D depth;
+uniform ivec2 depthSize;
+uniform int blockSize;
+
+out float maxDepth;
+
+void main()
+{
+	ivec2 first = ivec2(gl_FragCoord.xy) * blockSize;
+	float result = 0.0f;
+	for (int y = 0; y < blockSize; y++)
+		for (int x = 0; x < blockSize; x++)
+			result = max(result, texelFetch(depth, min(first + ivec2(x, y), depthSize - 1), 0).r);
+	maxDepth = result;
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+#version 330 core
+// Computes one slice of the occupancy bitfield, 8 macrocells along x per texel
+
+// Uniforms
+uniform sampler3D macrocells;
+// Visible densities below every entry (257 entries)
+uniform sampler1D visiblePrefix;
+uniform ivec3 cellCount;
+uniform int slice;
+
+out uint bits;
+
+void main()
+{
+	ivec2 p = ivec2(gl_FragCoord.xy);
+	uint result = 0u;
+	for (int i = 0; i < 8; i++) {
+		ivec3 cell = ivec3(p.x * 8 + i, p.y, slice);
+		if (cell.x >= cellCount.x)
+			break;
+		// The range holds a visible density if the count grows across it
+		ivec2 range = ivec2(texelFetch(macrocells, cell, 0).rg * 255.0f + 0.5f);
+		if (texelFetch(visiblePrefix, range.y + 1, 0).r > texelFetch(visiblePrefix, range.x, 0).r)
+			result |= 1u << uint(i);
+	}
+	bits = result;
+}
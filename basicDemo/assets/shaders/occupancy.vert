@@ -0,0 +1,8 @@
+#version 330 core
+// Atributte 0 of the vertex (full screen quad)
+layout (location = 0) in vec3 vertexPosition;
+
+void main()
+{
+    gl_Position = vec4(vertexPosition.xy, 0.0f, 1.0f);
+}
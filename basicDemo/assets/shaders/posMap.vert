@@ -6,6 +6,8 @@ layout (location = 1) in vec3 vertexColor;
 
 // Vertex data out data
 out vec3 vPos;
+// The depth pass and the raycasting pass must rasterize the same depths
+invariant gl_Position;
 
 uniform mat4 model;
 uniform mat4 view;
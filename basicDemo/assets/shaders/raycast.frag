@@ -1,36 +1,583 @@
 #version 330 core
+// Render mode, chosen when the shader variant is compiled:
+// MODE_DVR (emission/absorption, default), MODE_ISO (first-hit isosurface),
+// MODE_MIP / MODE_MINIP / MODE_AVG (maximum, minimum and average intensity projection)
+// THICK_SLAB can be added to any mode to restrict the rays to the space between two planes
+// CLIPPING shortens the rays to the crop box and the kept side of up to six clip planes
+// LIT adds gradient shading to MODE_DVR
+// PREINTEGRATED makes MODE_DVR classify ray segments with the pre-integrated table
+// VIRTUAL_TEXTURE reads the volume through the page table and the brick atlas,
+// and writes the brick each pixel needs into the feedback attachment
+// COMPRESSED reads the volume from the BC4 compressed slices of a 2D array texture
+// TIME_SERIES marks a texture that changes every timestep, gradients are computed on the fly
+// LOD picks the mip level (or virtual texture level) from the projected voxel
+// footprint and lengthens the step with it, distant views read coarser data
+// BRICKS marches one brick instance of MODE_DVR or MODE_ISO, from the eye and clipped to the
+// brick box, and writes premultiplied color for front to back blending; a segment
+// opaque on its own writes its depth, the occluder of the bricks behind it
+// SLABS marches the part of the ray between two depth planes of MODE_DVR or MODE_ISO, and
+// writes premultiplied color for front to back blending of the slabs
+#if !defined(MODE_DVR) && !defined(MODE_ISO) && !defined(MODE_MIP) && !defined(MODE_MINIP) && !defined(MODE_AVG)
+#define MODE_DVR
+#endif
+
 // Vertex color (interpolated/fragment)
 in vec3 vPos;
+#if defined(BRICKS)
+// Box of the brick (texture space)
+flat in vec3 vBrickFirst;
+flat in vec3 vBrickLast;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+// Opacity from which a segment hides what is behind it
+uniform float occlusionOpacity;
+#endif
 
-// Uniforms 
+// Uniforms
 uniform sampler3D texture1;
+uniform sampler2DArray compressedVolume;
 uniform sampler2D texture2;
 uniform vec2 windowSize;
 
+// Empty space skipping grid (r = min, g = max of every macrocell)
+uniform sampler3D macrocells;
+uniform ivec3 macrocellCount;
+uniform float macrocellSize;
+uniform vec3 volumeSize;
+#if defined(TILED)
+// Texture of the tile being drawn, first voxel and voxels per axis (ghost voxels included)
+uniform vec3 tileFirst;
+uniform vec3 tileSize;
+#endif
+// Voxel spacing relative to the finest axis, the model matrix scales the cube to the volume box
+uniform vec3 voxelSpacing;
+
+// Precomputed gradients (octahedral direction and sqrt companded magnitude)
+uniform sampler3D gradientNormals;
+uniform sampler3D gradientMagnitudes;
+uniform float maxGradientMagnitude;
+
+// Transfer function (opacities are defined for a one voxel step)
+uniform sampler1D transferFunction;
+uniform sampler2D preintegrationTable;
+// Macrocells with a visible density, one bit per cell (8 cells along x per texel)
+uniform usampler3D occupancy;
+#if defined(DISTANCE_SKIPPING)
+// Chebyshev distance of every macrocell to the nearest occupied one (0 = occupied)
+uniform usampler3D cellDistance;
+#endif
+#if defined(ADAPTIVE_STEP)
+// Step factor of every macrocell times 2, from its data frequency and the transfer function
+uniform usampler3D stepFactors;
+#endif
+
+// Sampling distance along the ray (voxels, the inverse of the samples per voxel)
+uniform float voxelStep;
+
+// Virtual texture, page table entry: xyz = atlas slot, w = resident level + 1
+#define MAX_LEVELS 12
+uniform usampler3D pageTable;
+uniform sampler3D brickAtlas;
+uniform float brickSize;
+uniform vec3 atlasSize;
+uniform int levelCount;
+uniform ivec3 levelBricks[MAX_LEVELS];
+uniform int levelPageOffset[MAX_LEVELS];
+uniform int levelFirstBrick[MAX_LEVELS];
+uniform vec3 levelSize[MAX_LEVELS];
+// Resolution level the rays ask for
+uniform int virtualLevel;
+
+// Level of detail selection: eye in texture space, size of a pixel at unit
+// distance and the coarsest level
+uniform vec3 eyePosition;
+uniform float pixelSpread;
+uniform float maxLod;
+// Frame number, varies the sample each pixel reports
+uniform int frameIndex;
+
+// Isosurface parameters
+uniform float isoValue;
+uniform vec3 isoColor;
+
+// Thick slab planes (xyz = normal, w = offset), the ray keeps dot(n, p) + w >= 0 for both
+uniform vec4 slabPlanes[2];
+
+#if defined(CLIPPING)
+// Clip planes (same convention as the slab planes) and crop box, texture space
+#define MAX_CLIP_PLANES 6
+uniform vec4 clipPlanes[MAX_CLIP_PLANES];
+uniform int clipPlaneCount;
+uniform vec3 cropFirst;
+uniform vec3 cropLast;
+#endif
+#if defined(SLABS)
+// Planes of the front and back of the slab (same convention as the slab planes)
+uniform vec4 passPlanes[2];
+#endif
+
 // Fragment Color
-out vec4 fragColor;
+layout (location = 0) out vec4 fragColor;
+#if defined(VIRTUAL_TEXTURE)
+// Brick index + 1 requested by this pixel (0 for none)
+layout (location = 1) out uint feedback;
+
+// A missing brick has priority, otherwise a random used brick keeps its slot alive
+uint requestedBrick = 0u;
+bool requestedMissing = false;
+int feedbackCountdown = 0;
+#endif
+
+// Secant/bisection iterations used to refine the isosurface hit
+const int refineSteps = 6;
+
+// Level of detail of the current sample
+float sampleLod = 0.0f;
+
+#if defined(VIRTUAL_TEXTURE)
+// Global index of a brick (same numbering as VirtualVolume::brickIndex)
+int brickId(int level, ivec3 brick)
+{
+	ivec3 count = levelBricks[level];
+	return levelFirstBrick[level] + (brick.z * count.y + brick.y) * count.x + brick.x;
+}
+
+// Translates p through the page table, falls back to the coarser resident brick
+float sampleVirtual(vec3 p, int level)
+{
+	ivec3 brick = clamp(ivec3(floor(p * levelSize[level] / brickSize)), ivec3(0), levelBricks[level] - 1);
+	uvec4 entry = texelFetch(pageTable, brick + ivec3(0, 0, levelPageOffset[level]), 0);
+	if (entry.w == 0u)
+		return 0.0f;
+
+	int resident = int(entry.w) - 1;
+	if (!requestedMissing) {
+		if (resident > level) {
+			// Refinement goes one level at a time from the resident brick
+			int wanted = resident - 1;
+			ivec3 wantedBrick = clamp(ivec3(floor(p * levelSize[wanted] / brickSize)), ivec3(0), levelBricks[wanted] - 1);
+			requestedBrick = uint(brickId(wanted, wantedBrick)) + 1u;
+			requestedMissing = true;
+		}
+		else if (feedbackCountdown-- == 0 || requestedBrick == 0u) {
+			requestedBrick = uint(brickId(level, brick)) + 1u;
+		}
+	}
+
+	// The entry of a missing brick is the one of its parent, found the same way
+	// as the page table does. Odd levels round up, so p may fall up to half a
+	// voxel past the parent brick, which the apron holds (nearly a voxel past
+	// farther ancestors, clamped to the apron)
+	ivec3 residentBrick = brick;
+	for (int i = level; i < resident; i++)
+		residentBrick = min(residentBrick / 2, levelBricks[i + 1] - 1);
+	vec3 position = p * levelSize[resident];
+	// The apron keeps the filtering inside the slot
+	vec3 local = clamp(position - vec3(residentBrick) * brickSize, vec3(0.0f), vec3(brickSize + 0.5f));
+	return texture(brickAtlas, (vec3(entry.xyz) * (brickSize + 2.0f) + 1.0f + local) / atlasSize).r;
+}
+#endif
+
+float sampleVolume(vec3 p)
+{
+#if defined(VIRTUAL_TEXTURE)
+	return sampleVirtual(p, min(max(virtualLevel, int(sampleLod)), levelCount - 1));
+#elif defined(COMPRESSED)
+	// One layer per slice, the hardware filters within a layer only
+	float z = clamp(p.z * volumeSize.z - 0.5f, 0.0f, volumeSize.z - 1.0f);
+	float z0 = floor(z);
+	float below = textureLod(compressedVolume, vec3(p.xy, z0), 0.0f).r;
+	float above = textureLod(compressedVolume, vec3(p.xy, min(z0 + 1.0f, volumeSize.z - 1.0f)), 0.0f).r;
+	return mix(below, above, z - z0);
+#elif defined(TILED)
+	// The ghost voxels cover the filter footprint past the tile box, the tiles have no mip chain
+	return textureLod(texture1, (p * volumeSize - tileFirst) / tileSize, 0.0f).r;
+#else
+	// Explicit level, implicit derivatives are undefined inside the ray loop
+	return textureLod(texture1, p, sampleLod).r;
+#endif
+}
+
+#if defined(BRICKS)
+// Window depth of a texture space point
+float windowDepth(vec3 p)
+{
+	vec4 clip = projection * view * model * vec4(p - 0.5f, 1.0f);
+	return clamp(0.5f * clip.z / clip.w + 0.5f, 0.0f, 1.0f);
+}
+#endif
+
+// Level whose voxels are as large as the pixel footprint at p
+float footprintLod(vec3 p)
+{
+	// Both measured in the finest voxels of level 0
+	float pixel = length((p - eyePosition) * volumeSize * voxelSpacing) * pixelSpread;
+	return clamp(log2(pixel), 0.0f, maxLod);
+}
+
+// Macrocell (integer coordinates) that contains the point p
+ivec3 macrocellAt(vec3 p)
+{
+	return clamp(ivec3(floor(p * volumeSize / macrocellSize)), ivec3(0), macrocellCount - 1);
+}
+
+// Distance along the ray from p to the exit of the box of macrocells [first, last]
+float macrocellExit(vec3 p, vec3 dir, ivec3 first, ivec3 last)
+{
+	vec3 cellMin = vec3(first) * macrocellSize / volumeSize;
+	vec3 cellMax = vec3(last + 1) * macrocellSize / volumeSize;
+	vec3 safeDir = mix(dir, vec3(1e-6f), equal(dir, vec3(0.0f)));
+	vec3 t = max((cellMin - p) / safeDir, (cellMax - p) / safeDir);
+	return min(min(t.x, t.y), t.z);
+}
+
+// True if the macrocell value range can change the result of the ray,
+// projected is the running max (MIP) or min (MinIP) of the ray
+bool macrocellActive(ivec3 cell, float projected)
+{
+	vec2 range = texelFetch(macrocells, cell, 0).rg;
+#if defined(MODE_ISO)
+	return range.x <= isoValue && isoValue <= range.y;
+#elif defined(MODE_MIP)
+	return range.y > projected;
+#elif defined(MODE_MINIP)
+	return range.x < projected;
+#elif defined(MODE_AVG)
+	// Zero cells add nothing to the sum, their length is still part of the average
+	return range.y > 0.0f;
+#else
+	// Some density of the cell is mapped to a non zero opacity
+	return (texelFetch(occupancy, ivec3(cell.x >> 3, cell.yz), 0).r & (1u << uint(cell.x & 7))) != 0u;
+#endif
+}
+
+vec3 octDecode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+	if (n.z < 0.0f)
+		n.xy = (1.0f - abs(n.yx)) * vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	return normalize(n);
+}
+
+// Two fetches instead of six central difference samples
+vec3 gradient(vec3 p)
+{
+#if defined(VIRTUAL_TEXTURE) || defined(TIME_SERIES) || defined(TILED)
+	// The precomputed gradients belong to a single monolithic volume
+	vec3 h = 1.0f / volumeSize;
+	return 0.5f * vec3(
+		sampleVolume(p + vec3(h.x, 0, 0)) - sampleVolume(p - vec3(h.x, 0, 0)),
+		sampleVolume(p + vec3(0, h.y, 0)) - sampleVolume(p - vec3(0, h.y, 0)),
+		sampleVolume(p + vec3(0, 0, h.z)) - sampleVolume(p - vec3(0, 0, h.z)));
+#else
+	float m = texture(gradientMagnitudes, p).r;
+	return octDecode(texture(gradientNormals, p).rg) * (m * m * maxGradientMagnitude);
+#endif
+}
+
+// Headlight Blinn-Phong, the light comes from the eye along the ray
+// returns the factor for the base color (x) and the specular term (y)
+vec2 lighting(vec3 p, vec3 rayDir)
+{
+	// The gradient is per voxel and the ray is in texture space, both are moved to the volume box
+	vec3 g = gradient(p) / voxelSpacing;
+	if (dot(g, g) < 1e-8f)
+		return vec2(1.0f, 0.0f);
+	vec3 n = normalize(-g);
+	vec3 l = -normalize(rayDir * volumeSize * voxelSpacing);
+	if (dot(n, l) < 0.0f)
+		n = -n;
+	float diffuse = max(dot(n, l), 0.0f);
+	float specular = pow(max(dot(n, l), 0.0f), 32.0f);
+	return vec2(0.2f + 0.8f * diffuse, 0.3f * specular);
+}
+
+vec3 shade(vec3 p, vec3 rayDir, vec3 baseColor)
+{
+	vec2 l = lighting(p, rayDir);
+	return baseColor * l.x + vec3(l.y);
+}
+
+// Texture coordinate of the center of the table entry of a density
+float tableCoord(float density)
+{
+	return density * (255.0f / 256.0f) + 0.5f / 256.0f;
+}
+
+// Clamps the ray interval [t0, t1] to the half space dot(n, p) + w >= 0
+void clampToPlane(vec4 plane, vec3 origin, vec3 dir, inout float t0, inout float t1)
+{
+	float dist = dot(plane.xyz, origin) + plane.w;
+	float speed = dot(plane.xyz, dir);
+	if (abs(speed) < 1e-8f) {
+		if (dist < 0.0f)
+			t1 = t0;
+		return;
+	}
+	float tPlane = -dist / speed;
+	if (speed > 0.0f)
+		t0 = max(t0, tPlane);
+	else
+		t1 = min(t1, tPlane);
+}
+
+// Clamps the ray interval [t0, t1] to the axis aligned box [boxFirst, boxLast]
+void clampToBox(vec3 boxFirst, vec3 boxLast, vec3 origin, vec3 dir, inout float t0, inout float t1)
+{
+	vec3 safeDir = mix(dir, vec3(1e-6f), equal(dir, vec3(0.0f)));
+	vec3 tFirst = (boxFirst - origin) / safeDir;
+	vec3 tLast = (boxLast - origin) / safeDir;
+	vec3 tNear = min(tFirst, tLast);
+	vec3 tFar = max(tFirst, tLast);
+	t0 = max(t0, max(max(tNear.x, tNear.y), tNear.z));
+	t1 = min(t1, min(min(tFar.x, tFar.y), tFar.z));
+}
+
+// Refines a crossing known to be inside [t0, t1] (v0 and v1 are the sample values minus the iso value)
+float refineHit(vec3 origin, vec3 dir, float t0, float v0, float t1, float v1)
+{
+	for (int i = 0; i < refineSteps; i++)
+	{
+		float tm = mix(t0, t1, clamp(v0 / (v0 - v1), 0.0f, 1.0f));
+		float vm = sampleVolume(origin + dir * tm) - isoValue;
+		if ((vm < 0.0f) == (v0 < 0.0f))
+		{
+			t0 = tm;
+			v0 = vm;
+		}
+		else
+		{
+			t1 = tm;
+			v1 = vm;
+		}
+	}
+	return mix(t0, t1, clamp(v0 / (v0 - v1), 0.0f, 1.0f));
+}
 
 void main()
 {
-	
+
 
 	vec4 color = vec4(0.0f,0.0f,0.0f,1.0f);
 	vec2 coord = gl_FragCoord.xy/ windowSize;
-	
+
+#if defined(VIRTUAL_TEXTURE)
+	// Sample (of the first 64) whose brick this pixel reports
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	feedbackCountdown = (pixel.x * 7 + pixel.y * 13 + frameIndex * 29) & 63;
+#endif
+
+#if defined(BRICKS)
+	// The ray starts at the eye and the brick box bounds it, so every brick
+	// samples the same points along the ray
+	vec3 rayIn = eyePosition;
+	vec3 rayDir = normalize(vPos - eyePosition);
+	float t = 0.0f;
+	float D = 1e30f;
+	clampToBox(vBrickFirst, vBrickLast, rayIn, rayDir, t, D);
+#else
 	vec3 rayDir = vec3(texture(texture2,coord).xyz - vPos);
 	vec3 rayIn = vPos;
 	float D = length(rayDir);
 	rayDir = normalize(rayDir);
 
-	for(float i=0.0f;i<D;i+=1.0f/256){
-	// Ai y Ci se consultan en la TF 
-		color.rgb += texture(texture1,rayIn).r * vec3(texture(texture1,rayIn).r) * color.a;
-		color.a *= 1 - texture(texture1,rayIn).r;
+	float t = 0.0f;
+#endif
+	// Voxels (of the finest axis) per texture space unit along this ray, the volume
+	// need not be cubic nor its voxels
+	float voxelsPerUnit = max(length(rayDir * volumeSize * voxelSpacing), 1e-6f);
+	float stepSize = voxelStep / voxelsPerUnit;
+#if defined(THICK_SLAB)
+	clampToPlane(slabPlanes[0], rayIn, rayDir, t, D);
+	clampToPlane(slabPlanes[1], rayIn, rayDir, t, D);
+#endif
+#if defined(CLIPPING)
+	// The removed parts are cut from the interval, they cost no samples
+	clampToBox(cropFirst, cropLast, rayIn, rayDir, t, D);
+	for (int i = 0; i < clipPlaneCount; i++)
+		clampToPlane(clipPlanes[i], rayIn, rayDir, t, D);
+#endif
+#if defined(SLABS)
+	clampToPlane(passPlanes[0], rayIn, rayDir, t, D);
+	clampToPlane(passPlanes[1], rayIn, rayDir, t, D);
+#endif
+	float rayLength = max(D - t, 0.0f);
+#if defined(BRICKS) || defined(SLABS)
+	// A sample on the face between two bricks (or slabs) belongs to the farther one
+	t = ceil(t / stepSize) * stepSize;
+#endif
+#if defined(BRICKS)
+	float occluderDepth = 1.0f;
+#endif
+
+	// Running value of the projection modes
+#if defined(MODE_MINIP)
+	float projected = 1.0f;
+#else
+	float projected = 0.0f;
+#endif
+
+#if defined(MODE_ISO)
+	float tPrev = 0.0f;
+	float vPrev = 0.0f;
+	bool hasPrev = false;
+#elif defined(MODE_DVR) && defined(PREINTEGRATED)
+	// Density at the front of the current segment and the segment length
+	float front = 0.0f;
+	float frontStep = stepSize;
+	bool hasFront = false;
+#endif
+#if (defined(BRICKS) || defined(SLABS)) && (defined(MODE_ISO) || (defined(MODE_DVR) && defined(PREINTEGRATED)))
+	// The first interval of the brick (or slab) starts at the last sample of the previous one
+	vec3 previous = rayIn + rayDir * (t - stepSize);
+	if (t >= stepSize && all(greaterThanEqual(previous, vec3(0.0f))) && all(lessThanEqual(previous, vec3(1.0f)))) {
+#if defined(MODE_ISO)
+		tPrev = t - stepSize;
+		vPrev = sampleVolume(previous) - isoValue;
+		hasPrev = true;
+#else
+		front = sampleVolume(previous);
+		hasFront = true;
+#endif
+	}
+#endif
+
+	while (t < D) {
+		vec3 p = rayIn + rayDir * t;
+#if defined(LOD)
+		// Samples one voxel of the selected level apart
+		sampleLod = footprintLod(p);
+		float stepLength = stepSize * exp2(sampleLod);
+#else
+		float stepLength = stepSize;
+#endif
+
+		ivec3 cell = macrocellAt(p);
+		if (!macrocellActive(cell, projected)) {
+#if defined(MODE_DVR) && defined(DISTANCE_SKIPPING)
+			// Every cell closer than the distance is empty, jump out of the whole cube
+			ivec3 radius = ivec3(int(texelFetch(cellDistance, cell, 0).r) - 1);
+			t += macrocellExit(p, rayDir, cell - radius, cell + radius) + 1e-4f;
+#else
+			// Jump to the next macrocell in a single step
+			t += macrocellExit(p, rayDir, cell, cell) + 1e-4f;
+#endif
+#if defined(MODE_ISO)
+			// A skipped cell has no crossing, start a new interval after it
+			hasPrev = false;
+#else
+#if defined(MODE_DVR) && defined(PREINTEGRATED)
+			hasFront = false;
+#endif
+			// Stay on the regular sampling grid to avoid wood grain artifacts
+			t = ceil(t / stepLength) * stepLength;
+#endif
+			continue;
+		}
+
+#if defined(ADAPTIVE_STEP)
+		// Smooth cells stretch the step up to their exit, rounded to the regular
+		// grid so the next cell starts on it, detailed ones take half steps
+		float stepFactor = float(texelFetch(stepFactors, cell, 0).r) * 0.5f;
+		if (stepFactor > 1.0f) {
+			float exitT = t + macrocellExit(p, rayDir, cell, cell);
+#if defined(SLABS)
+			// The next slab starts on the grid, no step crosses into it
+			exitT = min(exitT, D);
+#endif
+			stepLength = clamp(ceil(exitT / stepLength) * stepLength - t, stepLength, stepFactor * stepLength);
+		}
+		else
+			stepLength *= stepFactor;
+#endif
+
+		float density = sampleVolume(p);
+
+#if defined(MODE_ISO)
+		float v = density - isoValue;
+		if (hasPrev && (v >= 0.0f) != (vPrev >= 0.0f)) {
+			float tHit = refineHit(rayIn, rayDir, tPrev, vPrev, t, v);
+			color.rgb = shade(rayIn + rayDir * tHit, rayDir, isoColor);
+			// Nothing behind the surface shows through
+			color.a = 0.0f;
+#if defined(BRICKS)
+			occluderDepth = windowDepth(rayIn + rayDir * tHit);
+#endif
+			break;
+		}
+		tPrev = t;
+		vPrev = v;
+		hasPrev = true;
+#elif defined(MODE_MIP)
+		projected = max(projected, density);
+		// Nothing can be brighter than the maximum
+		if (projected >= 1.0f) break;
+#elif defined(MODE_MINIP)
+		projected = min(projected, density);
+		if (projected <= 0.0f) break;
+#elif defined(MODE_AVG)
+		projected += density * stepLength;
+#else
+	// Ai y Ci se consultan en la TF
+#if defined(PREINTEGRATED)
+		if (!hasFront) {
+			front = density;
+			frontStep = stepLength;
+			hasFront = true;
+			t += stepLength;
+			continue;
+		}
+		vec4 segment = texture(preintegrationTable, vec2(tableCoord(front), tableCoord(density)));
+		float alpha = 1.0f - exp(-segment.a * frontStep * voxelsPerUnit);
+		// The segment attenuates its own emission, the color averaged by extinction
+		// is scaled by the opacity of the segment and saturates with it
+		vec3 emission = segment.rgb / max(segment.a, 1e-6f) * alpha;
+		front = density;
+		frontStep = stepLength;
+#else
+		vec4 classified = texture(transferFunction, tableCoord(density));
+		// Opacity correction for steps different from the one voxel the function was defined for
+		float alpha = 1.0f - pow(1.0f - classified.a, stepLength * voxelsPerUnit);
+		vec3 emission = classified.rgb * alpha;
+#endif
+#if defined(LIT)
+		vec2 l = lighting(p, rayDir);
+		emission = emission * l.x + alpha * l.y;
+#endif
+		color.rgb += emission * color.a;
+		color.a *= 1 - alpha;
+#if defined(BRICKS)
+		if (occluderDepth == 1.0f && 1 - color.a >= occlusionOpacity)
+			occluderDepth = windowDepth(p);
+#endif
 		if(1 - color.a >= 0.99f) break;
-		rayIn += rayDir * 1.0f/256;
+#endif
+		t += stepLength;
 	}
+
+#if defined(MODE_MIP)
+	color.rgb = vec3(projected);
+#elif defined(MODE_MINIP)
+	// Rays that miss the slab have no minimum
+	color.rgb = vec3(rayLength > 0.0f ? projected : 0.0f);
+#elif defined(MODE_AVG)
+	color.rgb = vec3(rayLength > 0.0f ? projected / rayLength : 0.0f);
+#endif
+#if defined(BRICKS) || defined(SLABS)
+	// Opacity of the brick (or slab), the ones behind fill the remaining transmittance
+	color.a = 1.0f - color.a;
+#endif
+#if defined(BRICKS)
+	gl_FragDepth = occluderDepth;
+#elif !defined(SLABS)
 	color.a = 1.0f;
+#endif
 	fragColor = color;
+#if defined(VIRTUAL_TEXTURE)
+	feedback = requestedBrick;
+#endif
 
 
 }
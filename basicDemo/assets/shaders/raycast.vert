@@ -1,6 +1,11 @@
 #version 330 core
 // Atributte 0 of the vertex
 layout (location = 0) in vec3 vertexPosition;
+#if defined(BRICKS)
+// Box of the brick instance (texture space)
+layout (location = 1) in vec3 brickFirst;
+layout (location = 2) in vec3 brickLast;
+#endif
 
 // Uniforms
 uniform mat4 model;
@@ -10,9 +15,22 @@ uniform mat4 projection;
 
 // Vertex data out data
 out vec3 vPos;
+#if defined(BRICKS)
+flat out vec3 vBrickFirst;
+flat out vec3 vBrickLast;
+#endif
+// The depth pass and the raycasting pass must rasterize the same depths
+invariant gl_Position;
 
 void main()
 {
+#if defined(BRICKS)
+	vPos = mix(brickFirst, brickLast, vertexPosition + 0.5f);
+	vBrickFirst = brickFirst;
+	vBrickLast = brickLast;
+	gl_Position = projection * view * model * vec4(vPos - 0.5f, 1.0f);
+#else
     vPos = vertexPosition + 0.5f;
     gl_Position = projection * view * model * vec4(vertexPosition, 1.0f);
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,47 @@
+#version 330 core
+// Transfer function editor: histogram, opacity curve, control points and color strip
+
+#define MAX_POINTS 32
+
+// Uniforms
+uniform sampler1D transferFunction;
+uniform sampler1D histogram;
+uniform vec2 editorSize;
+uniform float stripHeight;
+// Density and opacity of every control point
+uniform vec2 points[MAX_POINTS];
+uniform int pointCount;
+uniform int selected;
+
+in vec2 uv;
+out vec4 color;
+
+void main()
+{
+	vec2 pixel = uv * editorSize;
+	vec4 entry = texture(transferFunction, uv.x);
+
+	// Colors of the table along the bottom
+	if (pixel.y < stripHeight) {
+		color = vec4(entry.rgb, 1.0f);
+		return;
+	}
+
+	float curveHeight = editorSize.y - stripHeight;
+	float y = (pixel.y - stripHeight) / curveHeight;
+	vec3 result = y < texture(histogram, uv.x).r ? vec3(0.3f) : vec3(0.1f);
+
+	// Distance to the curve in pixels, corrected by its slope so steep segments keep their width
+	float slope = dFdx(entry.a) * curveHeight;
+	float curve = abs(y - entry.a) * curveHeight / sqrt(1.0f + slope * slope);
+	result = mix(result, vec3(0.9f), 1.0f - smoothstep(0.5f, 1.5f, curve));
+
+	for (int i = 0; i < pointCount; i++) {
+		vec2 center = vec2(points[i].x * editorSize.x, stripHeight + points[i].y * curveHeight);
+		float d = distance(pixel, center);
+		if (d < 5.0f)
+			result = d < 3.5f ? (i == selected ? vec3(1.0f, 0.8f, 0.2f) : vec3(1.0f)) : vec3(0.0f);
+	}
+
+	color = vec4(result, 1.0f);
+}
@@ -0,0 +1,12 @@
+#version 330 core
+// Atributte 0 of the vertex (full screen quad, the viewport is the editor rectangle)
+layout (location = 0) in vec3 vertexPosition;
+
+// Position inside the editor [0, 1], y up
+out vec2 uv;
+
+void main()
+{
+	uv = vertexPosition.xy * 0.5f + 0.5f;
+	gl_Position = vec4(vertexPosition.xy, 0.0f, 1.0f);
+}
@@ -5,9 +5,36 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/glm.hpp>
 #include <iostream>
+#include <map>
 #include <stb_image.h>
 
 #include "Shader.h"
+#include "Volume.h"
+#include "MacrocellGrid.h"
+#include "GradientVolume.h"
+#include "TransferFunction.h"
+#include "PreintegrationTable.h"
+#include "BrickSource.h"
+#include "VirtualVolume.h"
+#include "BrickStreamer.h"
+#include "BrickFile.h"
+#include "CompressedVolume.h"
+#include "TimeSeries.h"
+#include "DerivedCache.h"
+#include "VolumeStatistics.h"
+#include "OccupancyGrid.h"
+#include "TransferFunctionEditor.h"
+#include "DistanceGrid.h"
+#include "GpuTimer.h"
+#include "ProxyGeometry.h"
+#include "BrickRenderer.h"
+#include "OcclusionPyramid.h"
+#include "SamplingRate.h"
+#include "TiledVolume.h"
+#include "SlabRenderer.h"
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
 
 
 using namespace std;
@@ -22,13 +49,66 @@ const char *windowTitle = "Basic Demo";
 // Window pointer
 GLFWwindow *window;
 
+// Raycaster variants, one per render mode
+enum renderMode {
+	RENDER_DVR,
+	RENDER_ISO,
+	RENDER_MIP,
+	RENDER_MINIP,
+	RENDER_AVG,
+	RENDER_MODE_COUNT
+};
+// Preprocessor define that selects each render mode in raycast.frag
+const char *renderModeDefines[RENDER_MODE_COUNT] = { "MODE_DVR", "MODE_ISO", "MODE_MIP", "MODE_MINIP", "MODE_AVG" };
+
 // Shader object
 Shader *shaderBasic;
 Shader *shaderDebug;
 Shader *shaderPosMap;
-Shader *shaderRaycast;
 Shader *shaderDebugBoth;
 Shader *shaderDebugPos;
+Shader *shaderGradient;
+Shader *shaderHistogram;
+Shader *shaderEditor;
+Shader *shaderOccupancy;
+Shader *shaderDistance;
+Shader *shaderBackground;
+Shader *shaderOcclusion;
+// Compiled raycaster variants, keyed by their list of defines
+map<string, Shader *> shaderRaycast;
+
+// Render mode currently displayed
+renderMode currentRenderMode = RENDER_DVR;
+// Density threshold of the isosurface mode
+float isoValue = 0.3f;
+
+// Restricts the rays to a slab perpendicular to the view direction
+bool thickSlab = false;
+// Gradient shading of the DVR mode
+bool litShading = false;
+// Classifies DVR ray segments with the pre-integrated transfer function
+bool preintegrated = false;
+
+// Samples per voxel along the rays (= and - double and halve it), the transfer function
+// opacities are defined for a one voxel step so the image does not depend on it
+float samplesPerVoxel = 1.0f;
+// Picks the mip level from the projected voxel footprint and steps accordingly
+bool lodSampling = true;
+// Levels of the volume texture mip chain
+int volumeMipLevels = 1;
+// Vertical field of view of the camera (degrees)
+const float fieldOfView = 45.0f;
+// Slab thickness in texture space units
+float slabThickness = 0.15f;
+// Signed distance of the slab center to the volume center along the view direction
+float slabOffset = 0.0f;
+// Clip planes in texture space, the rays keep dot(n, p) + w >= 0 (G adds one facing the camera, N removes them)
+vector<glm::vec4> clipPlanes;
+const int maxClipPlanes = 6;
+// Crop box in texture space, X/Y/Z pick the axis, [ ] move its lower face and , . its upper face (U resets)
+glm::vec3 cropFirst(0.0f);
+glm::vec3 cropLast(1.0f);
+int cropAxis = 0;
 
 // Index (GPU) of the geometry buffer
 unsigned int planeVBO;
@@ -44,10 +124,127 @@ unsigned int cubeVAO;
 
 unsigned int textureID;
 
+// Volume loaded at start up, a .raw (256^3 unsigned byte) or a .bvol brick file
+const char *volumePath = "assets/volumes/bonsai_256x256x256_uint8.raw";
+// Volume data kept in main memory, empty for brick files (only dim and spacing are set)
+Volume volume;
+// Voxel spacing of the raw volumes and the time series (--spacing XxYxZ), brick files store their own
+glm::vec3 rawSpacing(1.0f);
+// Voxel type of the raw volumes (--format u8|u16|f32), the wider ones are kept as bytes mapped from their value range
+string rawFormat = "u8";
+// Empty space skipping structure shared by every render mode
+MacrocellGrid macrocells;
+// Voxels per macrocell side
+const int macrocellSize = 16;
+// BC4 compressed copy of the volume
+CompressedVolume compressedVolume;
+// Keeps the volume BC4 compressed in VRAM instead of the 8 bit texture (--bc4)
+bool compressedStorage = false;
+// Derived data (macrocells, gradients, mip chain, BC4 blocks) of previous runs
+DerivedCache derivedCache;
+// Directory of the derived data cache
+const char *cacheDirectory = "cache";
+// Precomputed gradients used for shading
+GradientVolume gradients;
+// Computes the gradients with a fragment shader pass instead of the CPU threads (--gpu-gradients)
+bool gradientsOnGPU = false;
+// Histogram, range and percentiles of the volume
+VolumeStatistics volumeStatistics;
+// Computes the histograms scattering the voxels of the 3D texture instead of on the CPU threads (--gpu-statistics)
+bool statisticsOnGPU = false;
+// Histogram of the voxels inside the crop box, the transfer function window fits it
+VolumeStatistics cropStatistics;
+// Density to color and opacity mapping
+TransferFunction transferFunction;
+// Pre-integrated version of the transfer function
+PreintegrationTable preintegrationTable;
+// Macrocells the transfer function makes visible, rewritten on the GPU after every edit
+OccupancyGrid occupancy;
+// Transfer function overlay (E)
+TransferFunctionEditor editor;
+// Chebyshev distance of every macrocell to the nearest occupied one
+DistanceGrid distanceGrid;
+// DVR rays jump over the empty cube around a cell instead of the cell alone (K)
+bool distanceSkipping = false;
+// Boundary of the macrocells that can change a ray, rasterized instead of the cube
+ProxyGeometry proxyGeometry;
+// Occupied bricks drawn front to back, one ray segment each, instead of a single ray (F)
+BrickRenderer brickRenderer;
+bool brickRendering = false;
+// Bricks hidden behind the opaque bricks of the previous frame are not drawn (O), I prints how many
+OcclusionPyramid occlusionPyramid;
+bool occlusionCulling = true;
+// Opacity from which a brick segment hides the bricks behind it
+const float occlusionOpacity = 0.95f;
+// DVR rays step as far as the data frequency and the transfer function of every macrocell allow (J)
+SamplingRate samplingRate;
+bool adaptiveStep = true;
+// DVR and ISO images raycast in depth slabs within a GPU time budget, over several frames if needed (Q)
+SlabRenderer slabRenderer;
+bool slabRendering = false;
+// Times the raycasting pass, tagged with the empty space skipping used
+GpuTimer raycastTimer;
+// Frames left in the empty space skipping benchmark (B), the first half uses the macrocells
+int benchmarkFramesLeft = 0;
+const int benchmarkFrames = 240;
+
+// Bricked multi-resolution version of the volume
+BrickSource *brickSource = NULL;
+// Brick atlas and page table
+VirtualVolume virtualVolume;
+// Voxels per brick side
+const int brickSize = 32;
+// GPU memory for the brick atlas
+const size_t atlasBudget = size_t(256) << 20;
+// Samples the volume through the virtual texture instead of the monolithic texture
+bool virtualTexturing = false;
+// The volume does not fit a single 3D texture, the tiles or the virtual texture show it
+bool monolithicTexture = true;
+// Raw volumes over the 3D texture limit, split into tiles drawn front to back (DVR and ISO)
+TiledVolume tiledVolume;
+// Largest 3D texture side used, 0 for the driver limit (--max-texture <voxels>, lower values force the tiles)
+int maxTextureSize = 0;
+// Level the virtual texture rays ask for
+int virtualLevel = 0;
+// Loads the bricks the rays ask for
+BrickStreamer brickStreamer;
+// Coarsest levels made resident before the rays ask for anything
+const int prefillLevels = 2;
+// Most bricks uploaded per frame, keeps the frame time stable while streaming
+const int maxBrickUploadsPerFrame = 8;
+// Frames rendered so far
+int frameIndex = 0;
+
+// Time varying volume (--series or --delta-series), replaces the single volume
+TimeSeries timeSeries;
+bool timeSeriesMode = false;
+// Delta encoded series file, NULL for a series of raw files
+const char *deltaSeriesPath = NULL;
+// Voxels per brick side and keyframe interval of converted delta series
+const int deltaBrickSize = 16;
+const int deltaKeyframeInterval = 30;
+// printf pattern of the timestep files, number of timesteps and their size
+const char *seriesPattern = NULL;
+int seriesCount = 0;
+glm::ivec3 seriesDim(0);
+// Timesteps per second
+float seriesRate = 10.0f;
+// Timesteps read ahead of the one shown
+const int seriesPrefetch = 3;
+
 //Frame Buffer Object for position map
 unsigned int posMapFBO;
 //Texture for depth map
 unsigned int posMap;
+// Depth of the position map, keeps the farthest back face of the proxy geometry
+unsigned int posMapDepth;
+
+// Frame Buffer Object the virtual texture and brick raycasters render to (color + brick feedback)
+unsigned int sceneFBO;
+// Color of the scene frame buffer
+unsigned int sceneColor;
+// Depth of the scene frame buffer, a texture so the occlusion pyramid can read the brick occluders
+unsigned int sceneDepth;
 
 
 // Camera Start Position
@@ -62,10 +259,12 @@ float initialFoV = 45.0f;
 float speed = 3.0f; // 3 units / second
 float mouseSpeed = 0.005f;
 
-// Direction of the Camera
-glm::vec3 direction;
+// Direction of the Camera (matches the initial angles)
+glm::vec3 direction = glm::vec3(0, 0, -1);
 // Up vector for the Camera
-glm::vec3 up;
+glm::vec3 up = glm::vec3(0, 1, 0);
+// Camera of the image being drawn, the current one unless a slab image is still in progress
+glm::vec3 imagePosition, imageDirection, imageUp;
 
 
 //USED FOR DELTA TIME
@@ -74,8 +273,32 @@ float lastTime = 0;
 
 // Right button is currently pressed
 bool rightButtonPressed = false;
+// Key state in the previous frame, used to detect single key strokes
+bool keyWasPressed[GLFW_KEY_LAST + 1];
 
 
+/**
+ * Allocates the screen sized render targets with the current window size
+ * */
+void resizeRenderTargets()
+{
+	glBindTexture(GL_TEXTURE_2D, posMap);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, windowWidth, windowHeight, 0, GL_RGB, GL_FLOAT, NULL);
+	glBindRenderbuffer(GL_RENDERBUFFER, posMapDepth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, windowWidth, windowHeight);
+
+	glBindTexture(GL_TEXTURE_2D, sceneColor);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, windowWidth, windowHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glBindTexture(GL_TEXTURE_2D, sceneDepth);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, windowWidth, windowHeight, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+	brickStreamer.resize(windowWidth, windowHeight);
+	occlusionPyramid.resize(windowWidth, windowHeight);
+	slabRenderer.resize(windowWidth, windowHeight);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, brickStreamer.feedbackTextureID, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
 /**
  * Handles the window resize
  * @param{GLFWwindow} window pointer
@@ -88,6 +311,9 @@ void resize(GLFWwindow *window, int width, int height)
     windowHeight = height;
     // Sets the OpenGL viewport size and position
     glViewport(0, 0, windowWidth, windowHeight);
+	// A minimized window has no size
+	if (width > 0 && height > 0)
+		resizeRenderTargets();
 }
 /**
  * Initialize the glfw library
@@ -248,20 +474,442 @@ void buildGeometry()
 }
 
 
+/**
+ * Opens an out of core brick file, only the index is read, the bricks are
+ * streamed by the virtual texture as the rays ask for them
+ * @param{const char*} path of the .bvol file
+ * @returns{bool} true if the file could be opened
+ * */
+bool LoadBrickFile(const char* fileName) {
+	BrickFileSource *file = new BrickFileSource();
+	if (!file->open(fileName)) {
+		delete file;
+		return false;
+	}
+
+	delete brickSource;
+	brickSource = file;
+	volume.dim = file->levelDim(0);
+	volume.spacing = file->spacing();
+	volume.data.clear();
+
+	macrocells.build(*file);
+	macrocells.upload();
+
+	virtualVolume.create(brickSource, atlasBudget, prefillLevels);
+	brickStreamer.start(&virtualVolume);
+	cout << "bricks residentes: " << virtualVolume.residentCount << " de " << virtualVolume.brickSlot.size() << endl;
+
+	// There are no voxels in memory for the monolithic texture nor the gradients
+	monolithicTexture = false;
+	virtualTexturing = true;
+	return true;
+}
+
+/**
+ * Checks the extension of a path
+ * @param{const char*} path
+ * @param{const char*} extension with the dot
+ * @returns{bool} true if the path ends with the extension
+ * */
+bool hasExtension(const char* fileName, const char* extension) {
+	size_t length = strlen(fileName), extensionLength = strlen(extension);
+	return length >= extensionLength && strcmp(fileName + length - extensionLength, extension) == 0;
+}
+
+/**
+ * Reads a voxel spacing argument, invalid values are reported and ignored
+ * @param{const char*} spacing as XxYxZ (e.g. 0.5x0.5x2)
+ * @param{glm::vec3 &} spacing, only written if the argument is valid
+ * @returns{bool} true if the argument is valid
+ * */
+bool parseSpacing(const char* argument, glm::vec3 &spacing) {
+	glm::vec3 parsed;
+	if (sscanf(argument, "%fx%fx%f", &parsed.x, &parsed.y, &parsed.z) != 3 || glm::any(glm::lessThanEqual(parsed, glm::vec3(0.0f)))) {
+		cout << "ERROR::SPACING " << argument << " is not a valid voxel spacing" << endl;
+		return false;
+	}
+	spacing = parsed;
+	return true;
+}
+
+/**
+ * Takes the voxels per axis from a raw file name of the form name_XxYxZ_type.raw
+ * @param{const char*} path of the raw file
+ * @returns{glm::ivec3} voxels per axis, 256^3 if the name does not say
+ * */
+glm::ivec3 rawDimensions(const char* fileName) {
+	for (const char *c = strchr(fileName, '_'); c; c = strchr(c + 1, '_')) {
+		int x, y, z;
+		if (sscanf(c + 1, "%dx%dx%d", &x, &y, &z) == 3 && x > 0 && y > 0 && z > 0)
+			return glm::ivec3(x, y, z);
+	}
+	return glm::ivec3(256);
+}
+
+/**
+ * Opens the time series, the timesteps are read and uploaded while playing
+ * @returns{bool} true if the first timestep exists
+ * */
+bool LoadTimeSeries() {
+	bool opened = deltaSeriesPath ? timeSeries.openDeltas(deltaSeriesPath, macrocellSize, seriesPrefetch)
+		: timeSeries.open(seriesPattern, seriesCount, seriesDim, macrocellSize, seriesPrefetch);
+	if (!opened)
+		return false;
+	timeSeries.rate = seriesRate;
+
+	volume.dim = timeSeries.dim;
+	volume.spacing = rawSpacing;
+	volume.data.clear();
+
+	// Every cell is empty until the first timestep arrives
+	macrocells.cellSize = macrocellSize;
+	macrocells.count = (volume.dim + macrocellSize - 1) / macrocellSize;
+	macrocells.minMax.assign(size_t(macrocells.count.x) * macrocells.count.y * macrocells.count.z * 2, 0);
+	macrocells.upload();
+
+	// Only the plain 3D texture is updated per timestep
+	monolithicTexture = false;
+	virtualTexturing = false;
+	compressedStorage = false;
+	return true;
+}
+
+/**
+ * Builds the macrocells of the volume, or maps them from the derived data cache
+ * */
+void buildMacrocells() {
+	char name[32];
+	snprintf(name, sizeof(name), "macrocells%d", macrocellSize);
+	size_t size;
+	const unsigned char *cached = derivedCache.load(name, MacrocellGrid::version, size);
+
+	macrocells.cellSize = macrocellSize;
+	macrocells.count = (volume.dim + macrocellSize - 1) / macrocellSize;
+	if (cached && size == size_t(macrocells.count.x) * macrocells.count.y * macrocells.count.z * 2)
+		macrocells.minMax.assign(cached, cached + size);
+	else {
+		macrocells.build(volume, macrocellSize);
+		derivedCache.store(name, MacrocellGrid::version, { { macrocells.minMax.data(), macrocells.minMax.size() } });
+	}
+	macrocells.upload();
+}
+
+/**
+ * Computes the data frequency of the macrocells, or maps it from the derived data cache
+ * */
+void buildSamplingRate() {
+	char name[32];
+	snprintf(name, sizeof(name), "samplingrate%d", macrocellSize);
+	size_t size;
+	const unsigned char *cached = derivedCache.load(name, SamplingRate::version, size);
+
+	size_t cells = size_t(macrocells.count.x) * macrocells.count.y * macrocells.count.z;
+	if (cached && size == cells * sizeof(float)) {
+		samplingRate.cellSize = macrocellSize;
+		samplingRate.count = macrocells.count;
+		samplingRate.frequency.assign((const float *)cached, (const float *)cached + cells);
+	}
+	else {
+		samplingRate.build(volume, macrocellSize);
+		derivedCache.store(name, SamplingRate::version, { { samplingRate.frequency.data(), cells * sizeof(float) } });
+	}
+}
+
+/**
+ * Computes the gradients on the GPU, or on the CPU through the derived data cache,
+ * and prints which path ran
+ * @param{bool} the 3D texture of the volume exists (the GPU pass reads it)
+ * */
+void buildGradients(bool volumeTexture) {
+	double start = glfwGetTime();
+	const char *source = "gpu";
+	if (!volumeTexture || !gradientsOnGPU || !gradients.buildOnGPU(volume, textureID, shaderGradient, planeVAO)) {
+		size_t size;
+		const unsigned char *cached = derivedCache.load("gradients", GradientVolume::version, size);
+		source = "cache";
+		if (cached && size == volume.voxelCount() * 3)
+			gradients.upload(volume.dim, cached, cached + volume.voxelCount() * 2);
+		else {
+			gradients.build(volume);
+			gradients.upload();
+			derivedCache.store("gradients", GradientVolume::version,
+				{ { gradients.normals.data(), gradients.normals.size() }, { gradients.magnitudes.data(), gradients.magnitudes.size() } });
+			source = "cpu";
+		}
+	}
+	cout << "gradientes (" << source << ", " << int((glfwGetTime() - start) * 1000.0) << " ms)" << endl;
+}
+
+/**
+ * Prints the range, moments and percentiles of a histogram
+ * @param{const char *} what was counted
+ * @param{const char *} path that computed it
+ * @param{double} seconds it took
+ * @param{VolumeStatistics &} statistics
+ * */
+void printStatistics(const char *label, const char *source, double seconds, const VolumeStatistics &statistics) {
+	const StatisticsSummary &summary = statistics.summary;
+	cout << label << " (" << source << ", " << int(seconds * 1000.0) << " ms): min " << summary.minimum
+		<< ", max " << summary.maximum << ", media " << summary.mean << ", desviacion " << summary.standardDeviation
+		<< ", p1 " << statistics.percentile(0.01f) << ", p50 " << statistics.percentile(0.5f)
+		<< ", p99 " << statistics.percentile(0.99f) << endl;
+}
+
+/**
+ * Computes the histogram and statistics of the volume (GPU pass, CPU threads
+ * or derived data cache) and prints them
+ * @param{bool} the volume is in the 3D texture
+ * */
+void buildStatistics(bool volumeTexture) {
+	double start = glfwGetTime();
+	const char *source = "gpu";
+	if (!volumeTexture || !statisticsOnGPU || !volumeStatistics.computeOnGPU(textureID, volume.dim, shaderHistogram)) {
+		size_t size;
+		const unsigned char *cached = derivedCache.load("histogram", VolumeStatistics::version, size);
+		source = "cache";
+		if (!cached || !volumeStatistics.assign(cached, size)) {
+			volumeStatistics.compute(volume);
+			derivedCache.store("histogram", VolumeStatistics::version, { { &volumeStatistics.summary, sizeof(StatisticsSummary) },
+				{ volumeStatistics.bins.data(), volumeStatistics.bins.size() * sizeof(uint64_t) } });
+			source = "cpu";
+		}
+	}
+	printStatistics("histograma", source, glfwGetTime() - start, volumeStatistics);
+}
+
+/**
+ * Computes the statistics of the voxels inside the crop box (GPU pass or CPU threads)
+ * @returns{VolumeStatistics &} statistics of the box, the whole volume ones if nothing is cropped
+ * or the box voxels are neither in the 3D texture nor in memory
+ * */
+const VolumeStatistics &buildCropStatistics() {
+	if (cropFirst == glm::vec3(0.0f) && cropLast == glm::vec3(1.0f))
+		return volumeStatistics;
+
+	// Voxels whose centers are inside the box
+	glm::vec3 dim(volume.dim);
+	VoxelBox box = { glm::ivec3(glm::ceil(cropFirst * dim - 0.5f)), glm::ivec3(glm::floor(cropLast * dim - 0.5f)) };
+	double start = glfwGetTime();
+	const char *source = "gpu";
+	if (!textureID || !statisticsOnGPU || !cropStatistics.computeOnGPU(textureID, volume.dim, shaderHistogram, &box)) {
+		if (volume.data.size() != volume.voxelCount())
+			return volumeStatistics;
+		cropStatistics.compute(volume, &box);
+		source = "cpu";
+	}
+	if (!cropStatistics.summary.count)
+		return volumeStatistics;
+	printStatistics("histograma de la caja", source, glfwGetTime() - start, cropStatistics);
+	return cropStatistics;
+}
+
+/**
+ * Replaces the transfer function, only the changed entries are uploaded
+ * @param{vector<ControlPoint> &} new control points, sorted by density
+ * */
+void setTransferFunction(const vector<ControlPoint> &points) {
+	glm::ivec2 changed = transferFunction.setControlPoints(points);
+	if (changed.x > changed.y)
+		return;
+	transferFunction.upload();
+	preintegrationTable.update(transferFunction, 1.0f);
+	preintegrationTable.upload();
+}
+
+/**
+ * Fits the opacity ramp of the transfer function to the 1st - 99th percentile of a histogram
+ * @param{VolumeStatistics &} statistics of the volume or of the crop box
+ * */
+void autoWindow(const VolumeStatistics &statistics) {
+	float low = float(statistics.percentile(0.01f) / 255.0);
+	float high = glm::max(float(statistics.percentile(0.99f) / 255.0), low + 1.0f / 255.0f);
+	setTransferFunction({
+		{ low, glm::vec4(0.0f, 0.0f, 0.0f, 0.0f) },
+		{ high, glm::vec4(1.0f, 1.0f, 1.0f, 1.0f) } });
+	cout << "ventana: " << low << " - " << high << endl;
+}
+
+/**
+ * Encodes the volume to BC4, or maps the blocks from the derived data cache
+ * */
+void buildCompressedVolume() {
+	size_t size;
+	const unsigned char *cached = derivedCache.load("bc4", CompressedVolume::version, size);
+	double meanSquaredError;
+	if (cached && size >= sizeof(meanSquaredError)) {
+		memcpy(&meanSquaredError, cached, sizeof(meanSquaredError));
+		cached = compressedVolume.assign(volume.dim, cached + sizeof(meanSquaredError), size - sizeof(meanSquaredError), meanSquaredError) ? cached : NULL;
+	}
+	else
+		cached = NULL;
+
+	double start = glfwGetTime();
+	if (!cached) {
+		compressedVolume.encode(volume);
+		derivedCache.store("bc4", CompressedVolume::version, { { &compressedVolume.meanSquaredError, sizeof(double) },
+			{ compressedVolume.blocks.data(), compressedVolume.blocks.size() } });
+	}
+	compressedVolume.upload();
+
+	// Video memory of the whole volume, the gradients (2 + 1 bytes per voxel) included,
+	// against the R8 texture with its mip chain
+	size_t gradientBytes = volume.voxelCount() * 3;
+	size_t textureBytes = 0;
+	for (glm::ivec3 dim = volume.dim;; dim = glm::max(dim / 2, glm::ivec3(1))) {
+		textureBytes += size_t(dim.x) * dim.y * dim.z;
+		if (dim == glm::ivec3(1))
+			break;
+	}
+	cout << "BC4: " << (compressedVolume.compressedSize() >> 20) << " MB en lugar de " << (volume.voxelCount() >> 20)
+		<< " MB, volumen en memoria de video " << ((compressedVolume.compressedSize() + gradientBytes) >> 20) << " MB en lugar de "
+		<< ((textureBytes + gradientBytes) >> 20) << " MB, PSNR " << compressedVolume.psnr() << " dB, codificado en "
+		<< int((glfwGetTime() - start) * 1000.0) << " ms" << endl;
+}
+
+/**
+ * Loads the mip chain of the bound 3D texture (GL halves rounding down),
+ * box filtered on the CPU threads or mapped from the derived data cache
+ * */
+void buildMipChain() {
+	vector<glm::ivec3> dims;
+	size_t total = 0;
+	for (glm::ivec3 dim = volume.dim; glm::any(glm::greaterThan(dim, glm::ivec3(1)));) {
+		dim = glm::max(dim / 2, glm::ivec3(1));
+		dims.push_back(dim);
+		total += size_t(dim.x) * dim.y * dim.z;
+	}
+
+	size_t size;
+	const unsigned char *cached = derivedCache.load("mips", Volume::downsampleVersion, size);
+	vector<unsigned char> chain;
+	if (!cached || size != total) {
+		// Levels 1 and up, one after the other
+		chain.reserve(total);
+		Volume mip;
+		const Volume *fine = &volume;
+		for (const glm::ivec3 &dim : dims) {
+			mip = fine->downsample(dim);
+			chain.insert(chain.end(), mip.data.begin(), mip.data.end());
+			fine = &mip;
+		}
+		derivedCache.store("mips", Volume::downsampleVersion, { { chain.data(), chain.size() } });
+		cached = chain.data();
+	}
+
+	for (size_t level = 0; level < dims.size(); level++) {
+		const glm::ivec3 &dim = dims[level];
+		glTexImage3D(GL_TEXTURE_3D, GLint(level) + 1, GL_RED, dim.x, dim.y, dim.z, 0, GL_RED, GL_UNSIGNED_BYTE, cached);
+		cached += size_t(dim.x) * dim.y * dim.z;
+	}
+	volumeMipLevels = int(dims.size()) + 1;
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, volumeMipLevels - 1);
+	cout << "niveles mip: " << volumeMipLevels << endl;
+}
+
+/**
+ * Bricks the volume in memory and starts streaming it into the atlas, a raw
+ * volume that fits a 3D texture only pays for them while they are shown
+ * */
+void createVirtualTexture() {
+	if (brickSource)
+		return;
+	brickSource = new MemoryBrickSource(volume, brickSize);
+	virtualVolume.create(brickSource, atlasBudget, prefillLevels);
+	brickStreamer.start(&virtualVolume);
+	cout << "bricks residentes: " << virtualVolume.residentCount << " de " << virtualVolume.brickSlot.size() << endl;
+}
+
+/**
+ * Stops the streaming and deletes the atlas and the bricks in memory
+ * */
+void releaseVirtualTexture() {
+	brickStreamer.stop();
+	virtualVolume.release();
+	delete brickSource;
+	brickSource = NULL;
+	virtualLevel = 0;
+}
+
+/**
+ * Reads a raw volume of unsigned shorts or floats, prints the statistics of
+ * the stored values and keeps it as bytes spanning its value range
+ * @param{const char*} path of the raw file
+ * @param{glm::ivec3 &} voxels per axis
+ * @param{int} histogram bins of the stored values
+ * @returns{bool} true if the whole volume could be read
+ * */
+template <typename T>
+bool LoadWideRaw(const char* fileName, const glm::ivec3 &dim, int binCount) {
+	vector<T> voxels;
+	if (!Volume::readRaw(fileName, dim, voxels))
+		return false;
+
+	double start = glfwGetTime();
+	VolumeStatistics statistics;
+	statistics.compute(voxels.data(), dim, binCount);
+	printStatistics(("histograma " + rawFormat).c_str(), "cpu", glfwGetTime() - start, statistics);
+	volume.quantize(voxels.data(), dim, statistics.summary.minimum, statistics.summary.maximum);
+	return true;
+}
+
 bool LoadVolumeFromFile(const char* fileName) {
 
-	//assuming that the data at hand is a 256x256x256 unsigned byte data
-	int XDIM = 256, YDIM = 256, ZDIM = 256;
-	const int size = XDIM * YDIM * ZDIM;
+	if (hasExtension(fileName, ".bvol"))
+		return LoadBrickFile(fileName);
 
+	// The size comes from the file name, the voxel type from --format
+	glm::ivec3 dim = rawDimensions(fileName);
 
-	FILE *pFile = fopen(fileName, "rb");
-	if (NULL == pFile) {
+	// The data stays in main memory, the acceleration structures are built from it
+	bool loaded = rawFormat == "u16" ? LoadWideRaw<unsigned short>(fileName, dim, 4096)
+		: rawFormat == "f32" ? LoadWideRaw<float>(fileName, dim, 1024)
+		: volume.loadRaw(fileName, dim);
+	if (!loaded) {
 		return false;
 	}
-	GLubyte* pVolume = new GLubyte[size];
-	fread(pVolume, sizeof(GLubyte), size, pFile);
-	fclose(pFile);
+	volume.spacing = rawSpacing;
+
+	// Derived data is looked up by the content of the volume
+	derivedCache.open(cacheDirectory, volume);
+	buildMacrocells();
+	buildSamplingRate();
+
+	// The virtual texture of a previous volume, this one builds it when it is shown
+	releaseVirtualTexture();
+
+	// Volumes over the driver limit are split into tiles, or shown through the virtual texture
+	GLint maxSize, maxLayers;
+	if (compressedStorage) {
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+		glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+	}
+	else {
+		glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &maxSize);
+		maxLayers = maxSize;
+	}
+	if (maxTextureSize > 0) {
+		maxSize = glm::min(maxSize, maxTextureSize);
+		maxLayers = glm::min(maxLayers, maxTextureSize);
+	}
+	monolithicTexture = volume.dim.x <= maxSize && volume.dim.y <= maxSize && volume.dim.z <= maxLayers;
+	if (!monolithicTexture) {
+		// The projection modes of the tiles and the compressed volume read it through the virtual texture
+		createVirtualTexture();
+		virtualTexturing = compressedStorage || !tiledVolume.create(volume, maxSize, cubeVBO);
+		if (!virtualTexturing)
+			cout << "tiles: " << tiledVolume.count.x << "x" << tiledVolume.count.y << "x" << tiledVolume.count.z
+				<< ", " << (tiledVolume.bytes >> 20) << " MB" << endl;
+		buildStatistics(false);
+		return true;
+	}
+
+	if (compressedStorage) {
+		buildCompressedVolume();
+		buildGradients(false);
+		buildStatistics(false);
+		return true;
+	}
 
 	//load data into a 3D texture
 	glGenTextures(1, &textureID);
@@ -272,12 +920,172 @@ bool LoadVolumeFromFile(const char* fileName) {
 	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP);
 	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP);
 	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage3D(GL_TEXTURE_3D, 0, GL_RED, dim.x, dim.y, dim.z, 0, GL_RED, GL_UNSIGNED_BYTE, volume.data.data());
 
-	glTexImage3D(GL_TEXTURE_3D, 0, GL_RED, XDIM, YDIM, ZDIM, 0, GL_RED, GL_UNSIGNED_BYTE, pVolume);
-	delete[] pVolume;
+	buildMipChain();
+	buildGradients(true);
+	buildStatistics(true);
 	return true;
 }
+/**
+ * Deletes every compiled raycast variant, they are compiled again when needed
+ * */
+void clearRaycastShaders()
+{
+	for (auto &variant : shaderRaycast)
+		delete variant.second;
+	shaderRaycast.clear();
+}
+/**
+ * Densities that can change a ray in the current render mode, the same
+ * test the raycaster uses to skip a macrocell
+ * @returns{vector<unsigned char>} one entry per density, non zero if it counts
+ * */
+vector<unsigned char> visibleDensities()
+{
+	vector<unsigned char> visible(TransferFunction::size, 0);
+	for (int i = 0; i < TransferFunction::size; i++)
+	{
+		switch (currentRenderMode)
+		{
+		case RENDER_DVR:
+			visible[i] = transferFunction.table[i].a > 0.0f;
+			break;
+		case RENDER_ISO:
+			// The stored ranges are 8 bit, keep both neighbours of the iso value
+			visible[i] = i == int(floor(isoValue * 255.0f)) || i == int(ceil(isoValue * 255.0f));
+			break;
+		case RENDER_MIP:
+			visible[i] = i > 0;
+			break;
+		case RENDER_MINIP:
+			visible[i] = i < TransferFunction::size - 1;
+			break;
+		default:
+			// The average counts the length of the empty cells too
+			visible[i] = 1;
+			break;
+		}
+	}
+	return visible;
+}
+/**
+ * The tiles are drawn as boxes by the brick raycaster, the other modes
+ * read a tiled volume through the virtual texture
+ * @returns{bool} true if the frame is drawn tile by tile
+ * */
+bool tilesActive()
+{
+	return tiledVolume.loaded() && !virtualTexturing && (currentRenderMode == RENDER_DVR || currentRenderMode == RENDER_ISO);
+}
+/**
+ * The bricks composite with the under operator, only the modes that
+ * accumulate along the ray (DVR) or stop at the first hit (ISO) can use them
+ * @returns{bool} true if the frame is drawn brick by brick
+ * */
+bool bricksActive()
+{
+	return (brickRendering || tilesActive()) && (currentRenderMode == RENDER_DVR || currentRenderMode == RENDER_ISO);
+}
+/**
+ * Moves a plane of the model space box (the volume box centered at the origin) to texture space
+ * @param{glm::vec4 &} plane, the kept side is dot(n, x) + w >= 0
+ * @returns{glm::vec4} same plane in texture space (the box spans [0, 1])
+ * */
+glm::vec4 textureSpacePlane(const glm::vec4 &plane)
+{
+	// x = (p - 0.5) * extent
+	glm::vec3 normal = glm::vec3(plane) * volume.extent();
+	return glm::vec4(normal, plane.w - glm::dot(normal, glm::vec3(0.5f)));
+}
+/**
+ * The DVR rays use the step factors of the macrocells, the brick files and
+ * the timesteps have no voxels to measure the data frequency from
+ * @returns{bool} true if the raycaster steps adaptively
+ * */
+bool adaptiveStepActive()
+{
+	return adaptiveStep && currentRenderMode == RENDER_DVR && !timeSeriesMode && !samplingRate.frequency.empty();
+}
+/**
+ * The slabs composite with the under operator like the bricks, the bricks
+ * and the virtual texture feedback have their own frame buffer
+ * @returns{bool} true if the frame is raycast slab by slab
+ * */
+bool slabsActive()
+{
+	return slabRendering && !bricksActive() && !virtualTexturing && (currentRenderMode == RENDER_DVR || currentRenderMode == RENDER_ISO);
+}
+/**
+ * Bytes of everything a slab image depends on, a change starts a new image
+ * @param{glm::mat4 &} projection * view * model of the image
+ * @param{Shader *} raycast variant
+ * @returns{vector<unsigned char>} key of the image
+ * */
+vector<unsigned char> slabImageKey(const glm::mat4 &modelViewProjection, const Shader *raycast)
+{
+	vector<unsigned char> key;
+	auto append = [&key](const void *data, size_t size) {
+		key.insert(key.end(), (const unsigned char *)data, (const unsigned char *)data + size);
+	};
+	float settings[] = { isoValue, samplesPerVoxel, slabOffset, slabThickness, float(windowWidth), float(windowHeight) };
+	append(&modelViewProjection, sizeof(modelViewProjection));
+	append(&raycast, sizeof(raycast));
+	append(settings, sizeof(settings));
+	append(&cropFirst, sizeof(cropFirst));
+	append(&cropLast, sizeof(cropLast));
+	append(clipPlanes.data(), clipPlanes.size() * sizeof(glm::vec4));
+	append(transferFunction.table.data(), transferFunction.table.size() * sizeof(glm::vec4));
+	append(&timeSeries.shownSteps, sizeof(timeSeries.shownSteps));
+	return key;
+}
+/**
+ * Gets the raycast variant for the current render settings,
+ * compiling it the first time it is used
+ * @returns{Shader *} raycast shader
+ * */
+Shader *getRaycastShader()
+{
+	vector<string> defines = { renderModeDefines[currentRenderMode] };
+	if (thickSlab)
+		defines.push_back("THICK_SLAB");
+	if (litShading)
+		defines.push_back("LIT");
+	if (preintegrated)
+		defines.push_back("PREINTEGRATED");
+	if (virtualTexturing)
+		defines.push_back("VIRTUAL_TEXTURE");
+	else if (compressedStorage)
+		defines.push_back("COMPRESSED");
+	if (lodSampling)
+		defines.push_back("LOD");
+	if (timeSeriesMode)
+		defines.push_back("TIME_SERIES");
+	if (distanceSkipping)
+		defines.push_back("DISTANCE_SKIPPING");
+	if (bricksActive())
+		defines.push_back("BRICKS");
+	if (tilesActive())
+		defines.push_back("TILED");
+	if (slabsActive())
+		defines.push_back("SLABS");
+	if (adaptiveStepActive())
+		defines.push_back("ADAPTIVE_STEP");
+	if (!clipPlanes.empty() || cropFirst != glm::vec3(0.0f) || cropLast != glm::vec3(1.0f))
+		defines.push_back("CLIPPING");
+
+	string key;
+	for (const string &define : defines)
+		key += define + ";";
+
+	Shader *&shader = shaderRaycast[key];
+	if (!shader)
+		shader = new Shader("assets/shaders/raycast.vert", "assets/shaders/raycast.frag", defines);
+	return shader;
+}
 /**
  * Loads a texture into the GPU
  * @param{const char} path of the texture file
@@ -352,11 +1160,23 @@ bool init()
 	shaderBasic = new Shader("assets/shaders/basic.vert", "assets/shaders/basic.frag");
 	shaderPosMap = new Shader("assets/shaders/posMap.vert", "assets/shaders/posMap.frag");
 	shaderDebugPos = new Shader("assets/shaders/debugPosMap.vert", "assets/shaders/debugPosMap.frag");
-	shaderRaycast = new Shader("assets/shaders/raycast.vert", "assets/shaders/raycast.frag");
 	shaderDebugBoth = new Shader("assets/shaders/debugBoth.vert", "assets/shaders/debugBoth.frag");
+	shaderGradient = new Shader("assets/shaders/gradient.vert", "assets/shaders/gradient.frag");
+	shaderHistogram = new Shader("assets/shaders/histogram.vert", "assets/shaders/histogram.frag");
+	shaderEditor = new Shader("assets/shaders/tfEditor.vert", "assets/shaders/tfEditor.frag");
+	shaderOccupancy = new Shader("assets/shaders/occupancy.vert", "assets/shaders/occupancy.frag");
+	shaderDistance = new Shader("assets/shaders/distance.vert", "assets/shaders/distance.frag");
+	shaderBackground = new Shader("assets/shaders/debug.vert", "assets/shaders/background.frag");
+	shaderOcclusion = new Shader("assets/shaders/occlusion.vert", "assets/shaders/occlusion.frag");
 
     // Loads all the geometry into the GPU
     buildGeometry();
+	brickRenderer.create(cubeVBO);
+
+	// Transfer function and its pre-integrated table
+	transferFunction.upload();
+	preintegrationTable.update(transferFunction, 1.0f);
+	preintegrationTable.upload();
     // Loads the texture into the GPU
 
 	// configure position map FBO
@@ -378,30 +1198,116 @@ bool init()
 	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
 	// attach depth texture as FBO's depth buffer
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, posMap, 0);
+	// the proxy geometry can overlap itself, the depth test keeps the exit point
+	glGenRenderbuffers(1, &posMapDepth);
+	glBindRenderbuffer(GL_RENDERBUFFER, posMapDepth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, windowWidth, windowHeight);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, posMapDepth);
 	
 	//glDrawBuffer(GL_NONE);
 	//glReadBuffer(GL_NONE);
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+	// configure the scene FBO, the feedback attachment is created by the brick streamer
+	glGenFramebuffers(1, &sceneFBO);
+	glGenTextures(1, &sceneColor);
+	glBindTexture(GL_TEXTURE_2D, sceneColor);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glGenTextures(1, &sceneDepth);
+	glBindTexture(GL_TEXTURE_2D, sceneDepth);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	resizeRenderTargets();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneColor, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, sceneDepth, 0);
+	unsigned int sceneBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, sceneBuffers);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		cout << "ERROR:: scene frame buffer incomplete" << endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
 
 	//load volume
-	if (LoadVolumeFromFile("assets/volumes/bonsai_256x256x256_uint8.raw")) {
+	if (timeSeriesMode ? LoadTimeSeries() : LoadVolumeFromFile(volumePath)) {
 		cout <<"volumen cargado correctamente" << endl;
-
-		glEnable(GL_TEXTURE_3D);
-		glActiveTexture(textureID);
-
+		if (derivedCache.hits + derivedCache.misses > 0)
+			cout << "cache: " << derivedCache.hits << " aciertos, " << derivedCache.misses << " fallos" << endl;
+		cout << "macroceldas: " << macrocells.count.x << "x" << macrocells.count.y << "x" << macrocells.count.z << endl;
+		occupancy.create(macrocells.count);
+		distanceGrid.create(macrocells.count);
+		if (volumeStatistics.summary.count)
+			editor.setHistogram(volumeStatistics.bins);
 	}
 	else
 	{
 		cout << "error cargando el volumen" << endl;
 	}
+	// Everything derived is on the GPU or copied, the cache files can be unmapped
+	derivedCache.close();
 
 	cout << "id del volumen: " << textureID << endl;
 	cout << "id de la textura posicion: " << posMap << endl;
 
     return true;
 }
+/**
+ * Starts the empty space skipping benchmark: the same view is rendered with
+ * the macrocells and then with the distance grid, timed on the GPU
+ * */
+void startBenchmark()
+{
+	raycastTimer.poll(true);
+	raycastTimer.reset();
+	benchmarkFramesLeft = benchmarkFrames;
+	distanceSkipping = false;
+	cout << "benchmark: " << benchmarkFrames / 2 << " cuadros por modo" << endl;
+}
+/**
+ * Advances the benchmark one frame, switches the mode halfway and prints the averages at the end
+ * */
+void updateBenchmark()
+{
+	if (benchmarkFramesLeft <= 0)
+		return;
+	benchmarkFramesLeft--;
+	if (benchmarkFramesLeft == benchmarkFrames / 2)
+		distanceSkipping = true;
+	if (benchmarkFramesLeft > 0)
+		return;
+
+	raycastTimer.poll(true);
+	cout << "salto de espacio vacio: macroceldas " << raycastTimer.average(0) << " ms (" << raycastTimer.samples[0]
+		<< " cuadros), distancia " << raycastTimer.average(1) << " ms (" << raycastTimer.samples[1] << " cuadros)" << endl;
+}
+/**
+ * Prints the bricks per frame drawn and culled since the last call, then starts counting again
+ * */
+void printCullingStatistics()
+{
+	const BrickRenderer::Statistics &counts = brickRenderer.statistics;
+	double frames = double(max(counts.frames, uint64_t(1)));
+	cout << "bricks por cuadro (" << counts.frames << " cuadros): " << counts.drawn / frames << " dibujados, "
+		<< counts.frustumCulled / frames << " fuera del frustum, " << counts.occlusionCulled / frames << " ocluidos de "
+		<< brickRenderer.brickCount << " ocupados" << endl;
+	brickRenderer.resetStatistics();
+}
+
+/**
+ * Checks if a key has just been pressed, holding the key down only counts once
+ * @param{GLFWwindow} window pointer
+ * @param{int} glfw key code
+ * @returns{bool} true the first frame the key is down
+ * */
+bool keyPressedOnce(GLFWwindow *window, int key)
+{
+	bool pressed = glfwGetKey(window, key) == GLFW_PRESS;
+	bool once = pressed && !keyWasPressed[key];
+	keyWasPressed[key] = pressed;
+	return once;
+}
 /**
  * Process the keyboard input
  * There are ways of implementing this function through callbacks provide by
@@ -422,16 +1328,120 @@ void processKeyboardInput(GLFWwindow *window)
         delete shaderDebug;
 		delete shaderBasic;
 		delete shaderPosMap;
-		delete shaderRaycast;
 
 		shaderBasic = new Shader("assets/shaders/basic.vert", "assets/shaders/basic.frag");
 		shaderDebug = new Shader("assets/shaders/debug.vert", "assets/shaders/debug.frag");
 		shaderPosMap = new Shader("assets/shaders/posMap.vert", "assets/shaders/posMap.frag");
 		shaderDebugPos = new Shader("assets/shaders/debugPosMap.vert", "assets/shaders/debugPosMap.frag");
-		shaderRaycast = new Shader("assets/shaders/raycast.vert", "assets/shaders/raycast.frag");
 		shaderDebugBoth = new Shader("assets/shaders/debugBoth.vert", "assets/shaders/debugBoth.frag");
+		clearRaycastShaders();
     }
 
+	// Render mode selection
+	if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS)
+		currentRenderMode = RENDER_DVR;
+	if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS)
+		currentRenderMode = RENDER_ISO;
+	if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS)
+		currentRenderMode = RENDER_MIP;
+	if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS)
+		currentRenderMode = RENDER_MINIP;
+	if (glfwGetKey(window, GLFW_KEY_5) == GLFW_PRESS)
+		currentRenderMode = RENDER_AVG;
+	if (keyPressedOnce(window, GLFW_KEY_T))
+		thickSlab = !thickSlab;
+	if (keyPressedOnce(window, GLFW_KEY_L))
+		litShading = !litShading;
+	if (keyPressedOnce(window, GLFW_KEY_P))
+		preintegrated = !preintegrated;
+	if (keyPressedOnce(window, GLFW_KEY_SPACE) && timeSeriesMode)
+		timeSeries.setPlaying(!timeSeries.playing, glfwGetTime());
+	if (keyPressedOnce(window, GLFW_KEY_M))
+		lodSampling = !lodSampling;
+	// Empty space skipping with the distance grid and its benchmark against the macrocells
+	if (keyPressedOnce(window, GLFW_KEY_K))
+		distanceSkipping = !distanceSkipping;
+	if (keyPressedOnce(window, GLFW_KEY_B) && benchmarkFramesLeft == 0)
+		startBenchmark();
+	if (keyPressedOnce(window, GLFW_KEY_F))
+		brickRendering = !brickRendering;
+	if (keyPressedOnce(window, GLFW_KEY_O))
+		occlusionCulling = !occlusionCulling;
+	if (keyPressedOnce(window, GLFW_KEY_I))
+		printCullingStatistics();
+	if (keyPressedOnce(window, GLFW_KEY_Q))
+	{
+		slabRendering = !slabRendering;
+		cout << "slabs: " << (slabRendering ? "si" : "no") << ", " << slabRenderer.slabCount << " por imagen, presupuesto "
+			<< slabRenderer.drawBudget << " ms por dibujo y " << slabRenderer.frameBudget << " ms por cuadro" << endl;
+	}
+	if (keyPressedOnce(window, GLFW_KEY_J))
+	{
+		adaptiveStep = !adaptiveStep;
+		cout << "paso adaptativo: " << (adaptiveStep ? "si" : "no") << ", factor medio " << samplingRate.meanFactor << endl;
+	}
+	// Transfer function window from the histogram of the crop box
+	if (keyPressedOnce(window, GLFW_KEY_H) && volumeStatistics.summary.count)
+		autoWindow(buildCropStatistics());
+
+	// Transfer function editor: left button picks, inserts and drags the points
+	if (keyPressedOnce(window, GLFW_KEY_E))
+		editor.visible = !editor.visible;
+	vector<ControlPoint> points = transferFunction.points;
+	double cursorX, cursorY;
+	glfwGetCursorPos(window, &cursorX, &cursorY);
+	bool edited = editor.mouse(glm::vec2(cursorX, cursorY), glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS,
+		glm::ivec2(windowWidth, windowHeight), points);
+	if (keyPressedOnce(window, GLFW_KEY_DELETE))
+		edited = editor.removeSelected(points) || edited;
+	if (keyPressedOnce(window, GLFW_KEY_C))
+		edited = editor.cycleColor(points) || edited;
+	if (edited)
+		setTransferFunction(points);
+	if (keyPressedOnce(window, GLFW_KEY_V) && (monolithicTexture || tiledVolume.loaded()))
+	{
+		virtualTexturing = !virtualTexturing;
+		// The tiles keep theirs, their projection modes read through it
+		if (virtualTexturing)
+			createVirtualTexture();
+		else if (monolithicTexture)
+			releaseVirtualTexture();
+	}
+	// Resolution level of the virtual texture
+	if (keyPressedOnce(window, GLFW_KEY_PAGE_UP) && virtualTexturing)
+		virtualLevel = glm::min(virtualLevel + 1, int(virtualVolume.levelBricks.size()) - 1);
+	if (keyPressedOnce(window, GLFW_KEY_PAGE_DOWN))
+		virtualLevel = glm::max(virtualLevel - 1, 0);
+
+	// Clip planes through the volume center, the half facing the camera is cut away
+	if (keyPressedOnce(window, GLFW_KEY_G) && int(clipPlanes.size()) < maxClipPlanes)
+	{
+		clipPlanes.push_back(textureSpacePlane(glm::vec4(glm::normalize(direction), 0.0f)));
+	}
+	if (keyPressedOnce(window, GLFW_KEY_N))
+		clipPlanes.clear();
+	// Crop box
+	if (keyPressedOnce(window, GLFW_KEY_X))
+		cropAxis = 0;
+	if (keyPressedOnce(window, GLFW_KEY_Y))
+		cropAxis = 1;
+	if (keyPressedOnce(window, GLFW_KEY_Z))
+		cropAxis = 2;
+	if (keyPressedOnce(window, GLFW_KEY_U))
+	{
+		cropFirst = glm::vec3(0.0f);
+		cropLast = glm::vec3(1.0f);
+	}
+
+	// Sampling rate, pre-integration keeps the quality at fewer samples
+	float previousSamples = samplesPerVoxel;
+	if (keyPressedOnce(window, GLFW_KEY_EQUAL))
+		samplesPerVoxel = glm::min(samplesPerVoxel * 2.0f, 4.0f);
+	if (keyPressedOnce(window, GLFW_KEY_MINUS))
+		samplesPerVoxel = glm::max(samplesPerVoxel * 0.5f, 0.125f);
+	if (samplesPerVoxel != previousSamples)
+		cout << "muestras por voxel: " << samplesPerVoxel << endl;
+
 	// Check is the right click of the mouse is pressed
 	if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS) {
 		rightButtonPressed = true;
@@ -446,6 +1456,27 @@ void processKeyboardInput(GLFWwindow *window)
 
 	float deltaTime = currentTime - lastTime;
 
+	// Moves the isosurface threshold
+	if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
+		isoValue = glm::min(isoValue + 0.25f * deltaTime, 1.0f);
+	if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
+		isoValue = glm::max(isoValue - 0.25f * deltaTime, 0.0f);
+
+	// Moves the slab through the volume
+	if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
+		slabOffset = glm::min(slabOffset + 0.25f * deltaTime, 0.9f);
+	if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
+		slabOffset = glm::max(slabOffset - 0.25f * deltaTime, -0.9f);
+
+	// Moves the faces of the crop box along the selected axis, they keep 1% apart
+	if (glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS)
+		cropFirst[cropAxis] = glm::max(cropFirst[cropAxis] - 0.25f * deltaTime, 0.0f);
+	if (glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS)
+		cropFirst[cropAxis] = glm::min(cropFirst[cropAxis] + 0.25f * deltaTime, cropLast[cropAxis] - 0.01f);
+	if (glfwGetKey(window, GLFW_KEY_COMMA) == GLFW_PRESS)
+		cropLast[cropAxis] = glm::max(cropLast[cropAxis] - 0.25f * deltaTime, cropFirst[cropAxis] + 0.01f);
+	if (glfwGetKey(window, GLFW_KEY_PERIOD) == GLFW_PRESS)
+		cropLast[cropAxis] = glm::min(cropLast[cropAxis] + 0.25f * deltaTime, 1.0f);
 
 	if (rightButtonPressed) {
 
@@ -503,16 +1534,51 @@ void processKeyboardInput(GLFWwindow *window)
  * */
 void render()
 {
-	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)windowWidth / (float)windowHeight, .5f, 1000.0f);
+	glm::mat4 projection = glm::perspective(glm::radians(fieldOfView), (float)windowWidth / (float)windowHeight, .5f, 1000.0f);
 	//glm::mat4 projection = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, near_plane, far_plane);
 
+	// A slab image drawn over several frames keeps the camera it started with
+	bool slabs = slabsActive();
+	if (!slabs || slabRenderer.finished()) {
+		imagePosition = position;
+		imageDirection = direction;
+		imageUp = up;
+	}
 	glm::mat4 view = glm::lookAt(
-		position, // Camera is at (4,3,3), in world space
-		position + direction, // and looks at the origin
-		up  // Head is up (set to 0,-1,0 to look upside-down) 
+		imagePosition, // Camera is at (4,3,3), in world space
+		imagePosition + imageDirection, // and looks at the origin
+		imageUp  // Head is up (set to 0,-1,0 to look upside-down) 
 	);
 
-	glm::mat4 model = glm::mat4(1.0f); //model matrix: an identity matrix (model will be at the origin)
+	// The unit cube is scaled to the volume box, the voxels keep their spacing without resampling
+	glm::mat4 model = glm::scale(glm::mat4(1.0f), volume.extent());
+
+	// Never waits, the previous timestep stays on screen until the next one is read
+	if (timeSeriesMode && timeSeries.update(glfwGetTime(), macrocells))
+	{
+		occupancy.markDirty();
+		proxyGeometry.markDirty();
+		brickRenderer.markDirty();
+	}
+	// Follows the transfer function edits and the min/max grid of the timesteps
+	if (occupancy.update(transferFunction, macrocells.textureID, shaderOccupancy, planeVAO))
+		distanceGrid.markDirty();
+	if (distanceSkipping)
+		distanceGrid.update(occupancy.textureID, shaderDistance, planeVAO);
+	// The factors multiply the step, measured in voxels
+	if (adaptiveStepActive())
+		samplingRate.update(transferFunction, macrocells, 1.0f / samplesPerVoxel);
+	// The projection modes of a tiled volume read it through the virtual texture for this frame
+	bool tiledFallback = tiledVolume.loaded() && !virtualTexturing && !tilesActive();
+	if (tiledFallback)
+		virtualTexturing = true;
+	// The bricks and the tiles bound the rays themselves, they need no exit positions
+	bool bricks = bricksActive();
+	bool tiles = tilesActive();
+	if (bricks && !tiles)
+		brickRenderer.update(macrocells, volume.dim, brickSize, visibleDensities(), cropFirst, cropLast);
+	else if (!bricks)
+		proxyGeometry.update(macrocells, volume.dim, visibleDensities(), cropFirst, cropLast);
 
 	//RENDER POSITION MAP
 
@@ -527,18 +1593,23 @@ void render()
 
 	glViewport(0, 0, windowWidth, windowHeight);
 	glBindFramebuffer(GL_FRAMEBUFFER, posMapFBO);
-	// Clears the color and depth buffers from the frame buffer
+	// Clears the color and depth buffers from the frame buffer, the exit is the farthest back face
+	glClearDepth(0.0);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glDepthFunc(GL_GREATER);
 
-	// Binds the vertex array to be drawn
-	glBindVertexArray(cubeVAO);
-	// Renders the triangle gemotry
-	glDrawArrays(GL_TRIANGLES, 0, 36);
-	glBindVertexArray(0);
+	if (!bricks)
+		proxyGeometry.draw();
+
+	glDepthFunc(GL_LESS);
+	glClearDepth(1.0);
 
 	//bind back the regular framebuffer
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	
+	// The bricks are blended under what is already drawn, they start from a transparent target
+	if (bricks)
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
     // Clears the color and depth buffers from the frame buffer
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -563,20 +1634,226 @@ void render()
 	glCullFace(GL_BACK);
 	glEnable(GL_CULL_FACE);
 
-	shaderRaycast->use();
+	Shader *raycast = getRaycastShader();
+	raycast->use();
 
-	shaderRaycast->setMat4("model", model);
-	shaderRaycast->setMat4("view", view);
-	shaderRaycast->setMat4("projection", projection);
-	shaderRaycast->setVec2("windowSize", glm::vec2(windowWidth, windowHeight));
+	raycast->setMat4("model", model);
+	raycast->setMat4("view", view);
+	raycast->setMat4("projection", projection);
+	raycast->setVec2("windowSize", glm::vec2(windowWidth, windowHeight));
 
-	// Binds the vertex array to be drawn
-	glBindVertexArray(cubeVAO);
-	// Renders the triangle gemotry
-	glDrawArrays(GL_TRIANGLES, 0, 36);
-	glBindVertexArray(0);
+	// Volume, exit positions and macrocells
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_3D, timeSeriesMode ? timeSeries.textureID() : textureID);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, posMap);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_3D, macrocells.textureID);
+	glActiveTexture(GL_TEXTURE3);
+	glBindTexture(GL_TEXTURE_3D, gradients.normalTextureID);
+	glActiveTexture(GL_TEXTURE4);
+	glBindTexture(GL_TEXTURE_3D, gradients.magnitudeTextureID);
+	glActiveTexture(GL_TEXTURE5);
+	glBindTexture(GL_TEXTURE_1D, transferFunction.textureID);
+	glActiveTexture(GL_TEXTURE6);
+	glBindTexture(GL_TEXTURE_2D, preintegrationTable.textureID);
+	glActiveTexture(GL_TEXTURE9);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, compressedVolume.textureID);
+	glActiveTexture(GL_TEXTURE10);
+	glBindTexture(GL_TEXTURE_3D, occupancy.textureID);
+	glActiveTexture(GL_TEXTURE11);
+	glBindTexture(GL_TEXTURE_3D, distanceGrid.textureID);
+	glActiveTexture(GL_TEXTURE12);
+	glBindTexture(GL_TEXTURE_3D, samplingRate.textureID);
+	glActiveTexture(GL_TEXTURE0);
+	raycast->setInt("texture1", 0);
+	raycast->setInt("texture2", 1);
+	raycast->setInt("macrocells", 2);
+	raycast->setInt("gradientNormals", 3);
+	raycast->setInt("gradientMagnitudes", 4);
+	raycast->setFloat("maxGradientMagnitude", GradientVolume::maxMagnitude);
+	raycast->setInt("transferFunction", 5);
+	raycast->setInt("preintegrationTable", 6);
+	raycast->setInt("compressedVolume", 9);
+	raycast->setInt("occupancy", 10);
+	raycast->setInt("cellDistance", 11);
+	raycast->setInt("stepFactors", 12);
+	raycast->setFloat("voxelStep", 1.0f / samplesPerVoxel);
+
+	// Footprint of a pixel, the cube is the model space box [-0.5, 0.5] shifted to [0, 1]
+	raycast->setVec3("eyePosition", glm::vec3(glm::inverse(model) * glm::vec4(imagePosition, 1.0f)) + 0.5f);
+	raycast->setFloat("pixelSpread", 2.0f * tan(glm::radians(fieldOfView) * 0.5f) / float(windowHeight));
+	// The compressed layers and the timesteps have no mip chain
+	int lodLevels = virtualTexturing ? int(virtualVolume.levelBricks.size()) : compressedStorage || timeSeriesMode || tiles ? 1 : volumeMipLevels;
+	raycast->setFloat("maxLod", float(lodLevels - 1));
+
+	if (virtualTexturing)
+	{
+		virtualVolume.bind(raycast, 7, 8);
+		raycast->setInt("virtualLevel", virtualLevel);
+		raycast->setInt("frameIndex", frameIndex);
+	}
+	// The virtual texture raycaster also writes the brick feedback and the bricks
+	// blend with the destination alpha and leave their occluders in a depth texture,
+	// both need their own frame buffer
+	if (virtualTexturing || bricks)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		unsigned int noBrick[4] = { 0, 0, 0, 0 };
+		glClearBufferuiv(GL_COLOR, 1, noBrick);
+	}
+	raycast->setIVec3("macrocellCount", macrocells.count);
+	raycast->setFloat("macrocellSize", float(macrocells.cellSize));
+	raycast->setVec3("volumeSize", glm::vec3(volume.dim));
+	raycast->setVec3("voxelSpacing", volume.spacing / glm::min(volume.spacing.x, glm::min(volume.spacing.y, volume.spacing.z)));
 
-	
+	raycast->setFloat("isoValue", isoValue);
+	raycast->setVec3("isoColor", glm::vec3(0.9f, 0.8f, 0.6f));
+
+	if (thickSlab)
+	{
+		// Slab perpendicular to the view direction, around the volume center
+		glm::vec3 normal = glm::normalize(imageDirection);
+		raycast->setVec4("slabPlanes[0]", textureSpacePlane(glm::vec4(normal, -(slabOffset - 0.5f * slabThickness))));
+		raycast->setVec4("slabPlanes[1]", textureSpacePlane(glm::vec4(-normal, slabOffset + 0.5f * slabThickness)));
+	}
+	raycast->setInt("clipPlaneCount", int(clipPlanes.size()));
+	for (size_t i = 0; i < clipPlanes.size(); i++)
+		raycast->setVec4("clipPlanes[" + to_string(i) + "]", clipPlanes[i]);
+	raycast->setVec3("cropFirst", cropFirst);
+	raycast->setVec3("cropLast", cropLast);
+
+	if (bricks)
+	{
+		raycast->setFloat("occlusionOpacity", occlusionOpacity);
+		glm::vec3 eye = glm::vec3(glm::inverse(model) * glm::vec4(imagePosition, 1.0f)) + 0.5f;
+		bool occluders = !tiles && occlusionCulling && occlusionPyramid.readback();
+		if (!tiles)
+			brickRenderer.prepare(projection * view * model, eye, volume.extent(), occluders ? &occlusionPyramid : NULL);
+
+		// Back faces, a brick that holds the eye still gets its fragments. A fragment
+		// behind the occluder depth of an earlier brick is hidden and not blended
+		glCullFace(GL_FRONT);
+		glDepthFunc(GL_LEQUAL);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE_MINUS_DST_ALPHA, GL_ONE);
+		raycastTimer.begin(distanceSkipping ? 1 : 0);
+		if (tiles)
+			tiledVolume.draw(raycast, eye, volume.extent(), cropFirst, cropLast);
+		else
+			brickRenderer.draw();
+		raycastTimer.end();
+		glDepthFunc(GL_LESS);
+		if (occlusionCulling && !tiles)
+			occlusionPyramid.update(sceneDepth, shaderOcclusion, planeVAO);
+
+		// The background goes under whatever transmittance the bricks left,
+		// the brick feedback attachment keeps what the rays wrote
+		glCullFace(GL_BACK);
+		glDisable(GL_CULL_FACE);
+		glColorMaski(1, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		shaderBackground->use();
+		shaderBackground->setVec3("backgroundColor", glm::vec3(0.3f, 0.3f, 0.3f));
+		glDisable(GL_DEPTH_TEST);
+		glBindVertexArray(planeVAO);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+		glBindVertexArray(0);
+		glColorMaski(1, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		glEnable(GL_CULL_FACE);
+		glDisable(GL_BLEND);
+		glEnable(GL_DEPTH_TEST);
+		glClearColor(0.3f, 0.3f, 0.3f, 1.0f);
+	}
+	else if (slabs)
+	{
+		// Depths along the view direction that bound the volume box, cut in slabs of equal thickness
+		glm::vec3 normal = glm::normalize(imageDirection);
+		glm::vec3 extent = volume.extent();
+		float nearest = 1e30f, farthest = -1e30f;
+		for (int corner = 0; corner < 8; corner++) {
+			glm::vec3 p = (glm::vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1) - 0.5f) * extent;
+			float depth = glm::dot(normal, p - imagePosition);
+			nearest = glm::min(nearest, depth);
+			farthest = glm::max(farthest, depth);
+		}
+
+		slabRenderer.begin(slabImageKey(projection * view * model, raycast));
+		if (!slabRenderer.finished()) {
+			shaderPosMap->use();
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			proxyGeometry.draw();
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		}
+
+		raycast->use();
+		glDepthFunc(GL_LEQUAL);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE_MINUS_DST_ALPHA, GL_ONE);
+		for (int slab = slabRenderer.nextSlab(); slab >= 0; slab = slabRenderer.nextSlab()) {
+			// The boundary planes are shared by the two slabs on their sides (negated), no sample is taken twice
+			float front = glm::mix(nearest, farthest, float(slab) / slabRenderer.slabCount) - (slab == 0 ? 1e-3f : 0.0f);
+			float back = glm::mix(nearest, farthest, float(slab + 1) / slabRenderer.slabCount) + (slab + 1 == slabRenderer.slabCount ? 1e-3f : 0.0f);
+			raycast->setVec4("passPlanes[0]", textureSpacePlane(glm::vec4(normal, -glm::dot(normal, imagePosition) - front)));
+			raycast->setVec4("passPlanes[1]", -textureSpacePlane(glm::vec4(normal, -glm::dot(normal, imagePosition) - back)));
+			slabRenderer.beginSlab();
+			proxyGeometry.draw();
+			slabRenderer.endSlab();
+		}
+		glDepthFunc(GL_LESS);
+
+		// The last slab of the image was drawn, the background goes under it and it is shown from now on
+		if (slabRenderer.frameSlabs > 0 && slabRenderer.finished()) {
+			glDisable(GL_CULL_FACE);
+			glDisable(GL_DEPTH_TEST);
+			shaderBackground->use();
+			shaderBackground->setVec3("backgroundColor", glm::vec3(0.3f, 0.3f, 0.3f));
+			glBindVertexArray(planeVAO);
+			glDrawArrays(GL_TRIANGLES, 0, 6);
+			glBindVertexArray(0);
+			glEnable(GL_DEPTH_TEST);
+			glEnable(GL_CULL_FACE);
+			slabRenderer.complete();
+		}
+		glDisable(GL_BLEND);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		slabRenderer.present();
+	}
+	else
+	{
+		// The front faces of the proxy geometry overlap, a depth only pass leaves the nearest one to start the rays
+		shaderPosMap->use();
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		proxyGeometry.draw();
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+		raycast->use();
+		glDepthFunc(GL_LEQUAL);
+		raycastTimer.begin(distanceSkipping ? 1 : 0);
+		proxyGeometry.draw();
+		raycastTimer.end();
+		glDepthFunc(GL_LESS);
+	}
+	raycastTimer.poll(false);
+	updateBenchmark();
+
+	if (virtualTexturing)
+	{
+		// Bricks asked for in the previous frame go to the loader, finished ones to the atlas
+		brickStreamer.readFeedback(1);
+		brickStreamer.uploadLoaded(maxBrickUploadsPerFrame);
+	}
+	if (virtualTexturing || bricks)
+	{
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFBO);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBlitFramebuffer(0, 0, windowWidth, windowHeight, 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+	if (tiledFallback)
+		virtualTexturing = false;
+	editor.draw(transferFunction, shaderEditor, planeVAO, glm::ivec2(windowWidth, windowHeight));
+	frameIndex++;
 
     // Swap the buffer
     glfwSwapBuffers(window);
@@ -609,6 +1886,69 @@ void update()
  * */
 int main(int argc, char const *argv[])
 {
+	// basicDemo --convert <input .raw/.pvm> <XxYxZ> <output .bvol> [<spacing XxYxZ>]
+	if ((argc == 5 || argc == 6) && strcmp(argv[1], "--convert") == 0)
+	{
+		glm::ivec3 dim(0);
+		sscanf(argv[3], "%dx%dx%d", &dim.x, &dim.y, &dim.z);
+		glm::vec3 spacing(1.0f);
+		if (argc == 6)
+			parseSpacing(argv[5], spacing);
+		if (!convertToBrickFile(argv[2], dim, spacing, argv[4], brickSize, true))
+		{
+			std::cout << "error convirtiendo " << argv[2] << std::endl;
+			return -1;
+		}
+		std::cout << "convertido a " << argv[4] << std::endl;
+		return 0;
+	}
+	// basicDemo --convert-series <pattern> <count> <XxYxZ> <output .bdts>
+	if (argc == 6 && strcmp(argv[1], "--convert-series") == 0)
+	{
+		glm::ivec3 dim(0);
+		sscanf(argv[4], "%dx%dx%d", &dim.x, &dim.y, &dim.z);
+		if (!convertToDeltaSeries(argv[2], atoi(argv[3]), dim, argv[5], deltaBrickSize, deltaKeyframeInterval))
+		{
+			std::cout << "error convirtiendo " << argv[2] << std::endl;
+			return -1;
+		}
+		std::cout << "convertido a " << argv[5] << std::endl;
+		return 0;
+	}
+	// basicDemo [--bc4] [--series <pattern> <count> <XxYxZ> | --delta-series <file>] [--rate <timesteps per second>] [--spacing <XxYxZ>] [--max-texture <voxels>] [--gpu-gradients] [--gpu-statistics] [--format u8|u16|f32] [volume]
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--bc4") == 0)
+			compressedStorage = true;
+		else if (strcmp(argv[i], "--series") == 0 && i + 3 < argc)
+		{
+			timeSeriesMode = true;
+			seriesPattern = argv[i + 1];
+			seriesCount = atoi(argv[i + 2]);
+			sscanf(argv[i + 3], "%dx%dx%d", &seriesDim.x, &seriesDim.y, &seriesDim.z);
+			i += 3;
+		}
+		else if (strcmp(argv[i], "--delta-series") == 0 && i + 1 < argc)
+		{
+			timeSeriesMode = true;
+			deltaSeriesPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+			seriesRate = float(atof(argv[++i]));
+		else if (strcmp(argv[i], "--spacing") == 0 && i + 1 < argc)
+			parseSpacing(argv[++i], rawSpacing);
+		else if (strcmp(argv[i], "--max-texture") == 0 && i + 1 < argc)
+			maxTextureSize = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--gpu-gradients") == 0)
+			gradientsOnGPU = true;
+		else if (strcmp(argv[i], "--gpu-statistics") == 0)
+			statisticsOnGPU = true;
+		else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+			rawFormat = argv[++i];
+		else
+			volumePath = argv[i];
+	}
+
     // Initialize all the app components
     if (!init())
     {
@@ -626,6 +1966,32 @@ int main(int argc, char const *argv[])
 
     // Deletes the texture from the gpu
     glDeleteTextures(1, &textureID);
+	glDeleteTextures(1, &macrocells.textureID);
+	glDeleteTextures(1, &compressedVolume.textureID);
+	glDeleteTextures(1, &gradients.normalTextureID);
+	glDeleteTextures(1, &gradients.magnitudeTextureID);
+	glDeleteTextures(1, &transferFunction.textureID);
+	glDeleteTextures(1, &preintegrationTable.textureID);
+	occupancy.release();
+	distanceGrid.release();
+	proxyGeometry.release();
+	brickRenderer.release();
+	occlusionPyramid.release();
+	samplingRate.release();
+	tiledVolume.release();
+	slabRenderer.release();
+	raycastTimer.release();
+	editor.release();
+	brickStreamer.stop();
+	timeSeries.close();
+	timeSeries.release();
+	brickStreamer.release();
+	virtualVolume.release();
+	delete brickSource;
+	glDeleteFramebuffers(1, &sceneFBO);
+	glDeleteTextures(1, &sceneColor);
+	glDeleteTextures(1, &sceneDepth);
+	glDeleteRenderbuffers(1, &posMapDepth);
 
 
     // Deletes the vertex array from the GPU
@@ -642,6 +2008,7 @@ int main(int argc, char const *argv[])
     // Destroy the shader
     delete shaderBasic;
 	delete shaderDebug;
+	clearRaycastShaders();
 
     // Stops the glfw program
     glfwTerminate();